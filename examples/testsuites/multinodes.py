@@ -1,7 +1,8 @@
 # Copyright (c) Microsoft Corporation.
 # Licensed under the MIT license.
 
-from typing import cast
+import asyncio
+from typing import Awaitable, List, cast
 
 from assertpy import assert_that
 
@@ -9,6 +10,11 @@ from lisa import Environment, TestCaseMetadata, TestSuite, TestSuiteMetadata
 from lisa.node import RemoteNode
 from lisa.testsuite import simple_requirement
 from lisa.tools import Lscpu, Ntttcp
+from lisa.util.process import ExecutableResult
+
+
+async def _wait_all(*results: Awaitable[ExecutableResult]) -> List[ExecutableResult]:
+    return list(await asyncio.gather(*results))
 
 
 @TestSuiteMetadata(
@@ -30,8 +36,9 @@ class MultipleNodesDemo(TestSuite):
     def os_info(self, environment: Environment) -> None:
         self.log.info(f"node count: {len(environment.nodes)}")
 
-        for node in environment.nodes.list():
-            lscpu = node.tools[Lscpu]
+        # tools are checked and installed on all nodes in parallel.
+        lscpus = environment.nodes.tools_all[Lscpu]
+        for node, lscpu in zip(environment.nodes.list(), lscpus):
             core_count = lscpu.get_core_count()
             self.log.info(f"index: {node.index}, core_count: {core_count}")
 
@@ -57,10 +64,16 @@ class MultipleNodesDemo(TestSuite):
         ntttcp_client = client_node.tools[Ntttcp]
 
         server_process = ntttcp_server.run_async("-P 1 -t 5 -e")
-        client_result = ntttcp_client.run(
+        client_process = ntttcp_client.run_async(
             f"-s {server_node.internal_address} -P 1 -n 1 -t 5 -W 1"
         )
-        server_result = server_process.wait_result(timeout=10)
+        # processes on both nodes are waited in one event loop.
+        server_result, client_result = asyncio.run(
+            _wait_all(
+                server_process.wait_result_async(timeout=20),
+                client_process.wait_result_async(),
+            )
+        )
         self.log.info(
             f"server throughput: "
             f"{ntttcp_server.get_throughput(server_result.stdout)}"
@@ -0,0 +1,143 @@
+# Copyright (c) Microsoft Corporation.
+# Licensed under the MIT license.
+
+from pathlib import Path
+from typing import Dict, Tuple, Union
+
+from assertpy import assert_that
+
+from lisa import Node, TestCaseMetadata, TestSuite, TestSuiteMetadata
+from lisa.node import RemoteNode
+from lisa.operating_system import Posix
+from lisa.testsuite import simple_requirement
+from lisa.util import constants
+from lisa.util.perf_timer import create_timer
+from lisa.util.process import Process
+from lisa.util.shell import ConnectionInfo, SshShell, create_ssh_shell
+
+
+def _count_fds() -> int:
+    # it's available on Linux only.
+    fd_path = Path("/proc/self/fd")
+    return len(list(fd_path.iterdir())) if fd_path.exists() else 0
+
+
+def _measure(node_or_shell: Union[Node, SshShell], count: int) -> Tuple[float, int]:
+    """
+    Run short commands on a node or a shell, and return commands per second and
+    the peak count of file descriptors. The first command warms up, so the
+    connection and sessions are not counted.
+    """
+
+    peak_fds = 0
+
+    def _run(index: int) -> str:
+        nonlocal peak_fds
+        if isinstance(node_or_shell, Node):
+            process = node_or_shell.execute_async(f"echo {index}")
+        else:
+            process = Process(str(index), node_or_shell)
+            process.start(f"echo {index}", no_info_log=True)
+        # file descriptors are counted, when the command is running.
+        peak_fds = max(peak_fds, _count_fds())
+        return process.wait_result().stdout
+
+    _run(-1)
+    peak_fds = 0
+    timer = create_timer()
+    for index in range(count):
+        assert_that(_run(index)).is_equal_to(str(index))
+    return count / timer.elapsed(), peak_fds
+
+
+@TestSuiteMetadata(
+    area="demo",
+    category="performance",
+    description="""
+    this is an example test suite.
+    It measures how fast commands run on a remote node.
+    """,
+    requirement=simple_requirement(supported_os=[Posix]),
+)
+class ShellBenchmark(TestSuite):
+    @TestCaseMetadata(
+        description="""
+        This test case runs short commands in new channels and in the shell
+        session, and compare commands per second of them.
+        """,
+        priority=3,
+    )
+    def bench_shell_session(self, node: Node) -> None:
+        assert isinstance(node.shell, SshShell), "it needs a remote node"
+        self._compare(node, flag="use_session", name="session")
+
+    @TestCaseMetadata(
+        description="""
+        This test case runs short commands in new channels and by the agent, and
+        compare commands per second of them. The agent needs python3 on the node.
+        """,
+        priority=3,
+    )
+    def bench_agent(self, node: Node) -> None:
+        shell = node.shell
+        assert isinstance(shell, SshShell), "it needs a remote node"
+
+        original_use_agent = shell.use_agent
+        original_use_session = shell.use_session
+        shell.start_agent(node.working_path)
+        shell.use_session = False
+        try:
+            self._compare(node, flag="use_agent", name="agent")
+        finally:
+            shell.use_session = original_use_session
+            if not original_use_agent:
+                # the agent holds a channel, so it's not left running.
+                shell.stop_agent()
+
+    @TestCaseMetadata(
+        description="""
+        This test case runs short commands by each shell backend, and compare
+        commands per second and the peak count of file descriptors of them.
+        """,
+        priority=3,
+    )
+    def bench_shell_backend(self, node: Node) -> None:
+        assert isinstance(node, RemoteNode), "it needs a remote node"
+
+        command_count = 100
+        for backend in [constants.SHELL_BACKEND_SPUR, constants.SHELL_BACKEND_PARAMIKO]:
+            connection_info = ConnectionInfo(
+                **node.connection_info, shell_backend=backend
+            )
+            shell = create_ssh_shell(connection_info)
+            try:
+                shell.initialize()
+                rate, peak_fds = _measure(shell, command_count)
+            finally:
+                shell.close()
+            self.log.info(
+                f"{backend}: {rate:.1f} commands per second, "
+                f"peak file descriptors: {peak_fds}"
+            )
+
+    def _compare(self, node: Node, flag: str, name: str) -> None:
+        """
+        Measure commands in new channels, and with the flag of the shell turned
+        on, and log the speedup. The flag is restored after that.
+        """
+        shell = node.shell
+        command_count = 100
+        original_value = getattr(shell, flag)
+        rates: Dict[str, float] = {}
+        try:
+            for value in [False, True]:
+                setattr(shell, flag, value)
+                rate_name = name if value else "channel"
+                rates[rate_name], _ = _measure(node, command_count)
+                self.log.info(
+                    f"{rate_name}: {rates[rate_name]:.1f} commands per second"
+                )
+        finally:
+            setattr(shell, flag, original_value)
+
+        self.log.info(f"speedup: {rates[name] / rates['channel']:.1f}x")
@@ -4,14 +4,18 @@
 import asyncio
 import functools
 from argparse import Namespace
-from typing import Iterable, Optional, cast
+from datetime import timedelta
+from pathlib import Path
+from typing import Any, Dict, Iterable, List, Optional, Tuple, cast
 
 from lisa import notifier, schema
 from lisa.parameter_parser.runbook import RunbookBuilder
 from lisa.runner import RootRunner
+from lisa.sut_orchestrator.simulation import statistics as simulation_statistics
 from lisa.testselector import select_testcases
 from lisa.testsuite import TestCaseRuntimeData
 from lisa.util import LisaException, constants
+from lisa.util.clock import Clock, VirtualClock, set_clock
 from lisa.util.logger import enable_console_timestamp, get_logger
 from lisa.util.perf_timer import create_timer
 
@@ -21,6 +25,9 @@ _get_init_logger = functools.partial(get_logger, "init")
 def run(args: Namespace) -> int:
     enable_console_timestamp()
     builder = RunbookBuilder.from_path(args.runbook, args.variables)
+    shard_index, shard_count = _apply_shard(builder, args)
+    _apply_resume(args)
+    _apply_duration_history(builder)
 
     notifier_data = builder.partial_resolve(constants.NOTIFIER)
     if notifier_data:
@@ -33,6 +40,8 @@ def run(args: Namespace) -> int:
         test_pass=builder.partial_resolve(constants.TEST_PASS),
         run_name=constants.RUN_NAME,
         tags=builder.partial_resolve(constants.TAGS),
+        shard_index=shard_index,
+        shard_count=shard_count,
     )
     notifier.notify(run_message)
 
@@ -56,6 +65,123 @@ def run(args: Namespace) -> int:
     return runner.exit_code
 
 
+def simulate(args: Namespace) -> int:
+    enable_console_timestamp()
+    log = _get_init_logger("simulate")
+    concurrencies = cast(Optional[List[int]], args.concurrency) or [0]
+
+    reports: List[str] = []
+    run_name = constants.RUN_NAME
+    for concurrency in concurrencies:
+        # the runbook is loaded for each simulation, since runners change it. The
+        # shard name is added to the original run name, so it's not repeated.
+        builder = RunbookBuilder.from_path(args.runbook, args.variables)
+        constants.RUN_NAME = run_name
+        _apply_shard(builder, args)
+        _apply_duration_history(builder)
+        _apply_simulation(builder, args, concurrency)
+        concurrency = builder.partial_resolve(constants.CONCURRENCY) or 1
+
+        simulation_statistics.reset()
+        # modeled durations are spent on the virtual clock, so the predicted time
+        # doesn't depend on the real time of scheduling.
+        clock = VirtualClock()
+        set_clock(clock)
+        try:
+            runner = RootRunner(runbook_builder=builder)
+            asyncio.run(runner.start())
+        finally:
+            set_clock(Clock())
+        predicted_time = clock.time()
+
+        utilization = (
+            simulation_statistics.busy_time / (concurrency * predicted_time)
+            if predicted_time
+            else 0
+        )
+        reports.append(
+            f"concurrency: {concurrency}, "
+            f"predicted time: {timedelta(seconds=int(predicted_time))}, "
+            f"worker utilization: {utilization:.1%}, "
+            f"deployments: {simulation_statistics.deployments}, "
+            f"peak environments: {simulation_statistics.peak_environment_count}"
+        )
+
+    log.info("simulation summary")
+    for report in reports:
+        log.info(f"    {report}")
+    return 0
+
+
+def _apply_simulation(
+    builder: RunbookBuilder, args: Namespace, concurrency: int
+) -> None:
+    """
+    Replace the first platform by the simulation platform, and keep other
+    settings, like requirements.
+    """
+    if concurrency:
+        builder.raw_data[constants.CONCURRENCY] = concurrency
+
+    platforms: List[Dict[str, Any]] = builder.raw_data.get(constants.PLATFORM) or [
+        {constants.TYPE: constants.PLATFORM_READY}
+    ]
+    platform_data = platforms[0]
+    simulated_type = platform_data.get(constants.TYPE, constants.PLATFORM_READY)
+    simulation_data: Dict[str, Any] = platform_data.get(
+        constants.PLATFORM_SIMULATION, {}
+    )
+    if simulated_type != constants.PLATFORM_SIMULATION:
+        simulation_data.setdefault("platform_type", simulated_type)
+    for key in ["deploy_time", "initialize_time", "case_time", "delete_time"]:
+        value = getattr(args, key, None)
+        if value is not None:
+            simulation_data[key] = value
+
+    platform_data[constants.TYPE] = constants.PLATFORM_SIMULATION
+    platform_data[constants.PLATFORM_SIMULATION] = simulation_data
+    builder.raw_data[constants.PLATFORM] = [platform_data]
+
+
+def _apply_resume(args: Namespace) -> None:
+    resume_path = cast(Optional[str], getattr(args, "resume", None))
+    if not resume_path:
+        return
+    path = Path(resume_path).absolute()
+    if not path.is_dir():
+        raise LisaException(f"the run path to resume doesn't exist: '{path}'")
+    constants.RESUME_PATH = path
+    _get_init_logger().info(f"resuming from run path '{path}'")
+
+
+def _apply_duration_history(builder: RunbookBuilder) -> None:
+    # the history is in the cache folder, if it's not set in the runbook.
+    if not builder.partial_resolve(constants.DURATION_HISTORY_PATH):
+        builder.raw_data[constants.DURATION_HISTORY_PATH] = str(
+            constants.CACHE_PATH / "durations"
+        )
+
+
+def _apply_shard(builder: RunbookBuilder, args: Namespace) -> Tuple[int, int]:
+    # the command line arguments overwrite values in runbook.
+    for key in [constants.SHARD_INDEX, constants.SHARD_COUNT]:
+        value = getattr(args, key, None)
+        if value is not None:
+            builder.raw_data[key] = value
+
+    shard_index = builder.partial_resolve(constants.SHARD_INDEX) or 0
+    shard_count = builder.partial_resolve(constants.SHARD_COUNT) or 1
+    if shard_count > 1:
+        # the run name is used in names of resources and reports, so make it
+        # different for each shard.
+        constants.RUN_NAME = f"{constants.RUN_NAME}_s{shard_index}"
+        _get_init_logger().info(
+            f"running shard {shard_index} of {shard_count}, "
+            f"run name is '{constants.RUN_NAME}'"
+        )
+    return shard_index, shard_count
+
+
 # check runbook
 def check(args: Namespace) -> int:
     RunbookBuilder.from_path(args.runbook, args.variables)
@@ -10,7 +10,7 @@ from enum import Enum
 from functools import partial
 from pathlib import Path
 from threading import Lock
-from typing import TYPE_CHECKING, Any, Dict, List, Optional
+from typing import TYPE_CHECKING, Any, Dict, List, Optional, Tuple
 
 from dataclasses_json import dataclass_json
 from marshmallow import validate
@@ -74,6 +74,20 @@ def _get_environment_id() -> int:
     return id
 
 
+def _get_requirement_key(requirement: Any) -> str:
+    """
+    Return a canonical text of a requirement. Requirements are shared by test
+    results of the same case, so the text is generated once, and it's cached on
+    the requirement. Requirements are not changed after cases are loaded.
+    """
+    cached: Optional[Tuple[int, str]] = getattr(requirement, "_requirement_key", None)
+    # a copy has the cached text of the original one, but it has another id.
+    if cached is None or cached[0] != id(requirement):
+        cached = (id(requirement), repr(requirement))
+        requirement._requirement_key = cached
+    return cached[1]
+
+
 @dataclass
 class EnvironmentMessage(MessageBase):
     type: str = "Environment"
@@ -188,6 +202,20 @@ class Environment(ContextMixin, InitializableMixin):
         # contains environment name, which is not set in __init__.
         self._log_path: Optional[Path] = None
 
+        # the capability and check results are cached by the capability
+        # generation, it's changed when status or nodes are changed.
+        self._status_generation: int = 0
+        self._capability: Optional[Tuple[int, EnvironmentSpace]] = None
+        self._check_results: Dict[str, search_space.ResultReason] = {}
+        self._check_results_generation: int = -1
+        self._check_results_lock: Lock = Lock()
+        self._check_hits: int = 0
+        self._check_misses: int = 0
+        # information is queried from nodes by hooks, it's cached until the
+        # environment or nodes are changed, like connected or rebooted.
+        self._information: Optional[Tuple[int, Dict[str, str]]] = None
+        self._information_lock: Lock = Lock()
+
         if not runbook.nodes_requirement and not runbook.nodes:
             raise LisaException("not found any node or requirement in environment")
 
@@ -221,6 +249,7 @@ class Environment(ContextMixin, InitializableMixin):
     @status.setter
     def status(self, value: EnvironmentStatus) -> None:
         self._status = value
+        self._status_generation += 1
         environment_message = EnvironmentMessage(
             name=self.name, status=self._status, runbook=self.runbook
         )
@@ -257,10 +286,21 @@ class Environment(ContextMixin, InitializableMixin):
         return self._log_path
 
     def close(self) -> None:
+        self._log_check_cache_stats()
         self.nodes.close()
 
+    @property
+    def capability_generation(self) -> int:
+        # both generations are increased only, so the sum is changed, if any of
+        # them is changed.
+        return self._status_generation + self.nodes.generation
+
     @property
     def capability(self) -> EnvironmentSpace:
+        generation = self.capability_generation
+        if self._capability and self._capability[0] == generation:
+            return self._capability[1]
+
         result = EnvironmentSpace(topology=self.runbook.topology)
         for node in self.nodes.list():
             result.nodes.append(node.capability)
@@ -269,20 +309,71 @@ class Environment(ContextMixin, InitializableMixin):
             and self.runbook.nodes_requirement
         ):
             result.nodes.extend(self.runbook.nodes_requirement)
+        self._capability = (generation, result)
         return result
 
+    def check_requirement(
+        self, requirement: EnvironmentSpace
+    ) -> search_space.ResultReason:
+        """
+        Check the requirement on the capability of this environment. Results are
+        cached by the requirement and capability generation, so the scheduler can
+        check the same pair again and again with a dict lookup.
+
+        Return:
+            a copy of the cached result, so the caller can merge it.
+        """
+        key = _get_requirement_key(requirement)
+        generation = self.capability_generation
+        with self._check_results_lock:
+            if self._check_results_generation != generation:
+                self._check_results.clear()
+                self._check_results_generation = generation
+            check_result = self._check_results.get(key)
+            if check_result is None:
+                self._check_misses += 1
+                check_result = requirement.check(self.capability)
+                self._check_results[key] = check_result
+            else:
+                self._check_hits += 1
+        return search_space.ResultReason(
+            result=check_result.result, reasons=list(check_result.reasons)
+        )
+
+    def _log_check_cache_stats(self) -> None:
+        total = self._check_hits + self._check_misses
+        if total:
+            self._log.debug(
+                f"requirement check cache: hits {self._check_hits}, "
+                f"misses {self._check_misses}, "
+                f"hit rate {self._check_hits / total:.2%}"
+            )
+
+    @property
+    def information_generation(self) -> int:
+        return self.capability_generation + sum(
+            x.information_generation for x in self.nodes.list()
+        )
+
     def get_information(self) -> Dict[str, str]:
-        final_information: Dict[str, str] = {}
-        informations: List[
-            Dict[str, str]
-        ] = plugin_manager.hook.get_environment_information(environment=self)
-        # reverse it, since it's FILO order,
-        # try basic earlier, and they are allowed to be overwritten
-        informations.reverse()
-        for current_information in informations:
-            final_information.update(current_information)
-
-        return final_information
+        # the lock makes concurrent callers wait for one query.
+        with self._information_lock:
+            generation = self.information_generation
+            if self._information and self._information[0] == generation:
+                return self._information[1].copy()
+
+            final_information: Dict[str, str] = {}
+            informations: List[
+                Dict[str, str]
+            ] = plugin_manager.hook.get_environment_information(environment=self)
+            # reverse it, since it's FILO order,
+            # try basic earlier, and they are allowed to be overwritten
+            informations.reverse()
+            for current_information in informations:
+                final_information.update(current_information)
+
+            self._information = (generation, final_information)
+            return final_information.copy()
 
     def __validate_single_default(
         self, has_default: bool, is_default: Optional[bool]
@@ -3,11 +3,27 @@
 
 from __future__ import annotations
 
+import io
 import pathlib
+import tarfile
+import time
 from hashlib import sha256
-from typing import TYPE_CHECKING, Any, Dict, List, Optional, Type, TypeVar, Union, cast
-
-from lisa.util import InitializableMixin, LisaException, constants
+from threading import Lock
+from typing import (
+    TYPE_CHECKING,
+    Any,
+    Callable,
+    Dict,
+    List,
+    Optional,
+    Tuple,
+    Type,
+    TypeVar,
+    Union,
+    cast,
+)
+
+from lisa.util import InitializableMixin, KeyLocks, LisaException, constants
 from lisa.util.logger import get_logger
 from lisa.util.perf_timer import create_timer
 from lisa.util.process import ExecutableResult, Process
@@ -191,10 +207,12 @@ class Tool(InitializableMixin):
         no_error_log: bool = False,
         no_info_log: bool = True,
         cwd: Optional[pathlib.PurePath] = None,
+        line_handler: Optional[Callable[[str], None]] = None,
     ) -> Process:
         """
         Run a command async and return the Process. The process is used for async, or
-        kill directly.
+        kill directly. It can be awaited in asyncio also, like
+        "result = await tool.run_async(...)".
         """
         if parameters:
             command = f"{self.command} {parameters}"
@@ -203,7 +221,8 @@ class Tool(InitializableMixin):
 
         command_key = f"{command}|{shell}|{sudo}|{cwd}"
         process = self.__cached_results.get(command_key, None)
-        if force_run or not process:
+        # the line handler needs output, so the cached result is not used.
+        if force_run or line_handler or not process:
             process = self.node.execute_async(
                 command,
                 shell=shell,
@@ -211,6 +230,7 @@ class Tool(InitializableMixin):
                 no_error_log=no_error_log,
                 cwd=cwd,
                 no_info_log=no_info_log,
+                line_handler=line_handler,
             )
             self.__cached_results[command_key] = process
         else:
@@ -227,6 +247,7 @@ class Tool(InitializableMixin):
         no_info_log: bool = True,
         cwd: Optional[pathlib.PurePath] = None,
         timeout: int = 600,
+        line_handler: Optional[Callable[[str], None]] = None,
     ) -> ExecutableResult:
         """
         Run a process and wait for result.
@@ -239,6 +260,7 @@ class Tool(InitializableMixin):
             no_error_log=no_error_log,
             no_info_log=no_info_log,
             cwd=cwd,
+            line_handler=line_handler,
         )
         return process.wait_result(timeout=timeout)
 
@@ -275,9 +297,11 @@ class CustomScript(Tool):
         files: List[pathlib.PurePath],
         command: Optional[str] = None,
         dependencies: Optional[List[Type[Tool]]] = None,
+        builder: Optional[CustomScriptBuilder] = None,
     ) -> None:
         self._name = name
         self._command = command
+        self._builder = builder
 
         super().__init__(node)
         self._local_path = local_path
@@ -298,6 +322,7 @@ class CustomScript(Tool):
         no_error_log: bool = False,
         no_info_log: bool = True,
         cwd: Optional[pathlib.PurePath] = None,
+        line_handler: Optional[Callable[[str], None]] = None,
     ) -> Process:
         if cwd is not None:
             raise LisaException("don't set cwd for script")
@@ -310,6 +335,7 @@ class CustomScript(Tool):
             no_error_log=no_error_log,
             no_info_log=no_info_log,
             cwd=self._cwd,
+            line_handler=line_handler,
         )
 
     def run(
@@ -322,6 +348,7 @@ class CustomScript(Tool):
         no_info_log: bool = True,
         cwd: Optional[pathlib.PurePath] = None,
         timeout: int = 600,
+        line_handler: Optional[Callable[[str], None]] = None,
     ) -> ExecutableResult:
         process = self.run_async(
             parameters=parameters,
@@ -331,6 +358,7 @@ class CustomScript(Tool):
             no_error_log=no_error_log,
             no_info_log=no_info_log,
             cwd=cwd,
+            line_handler=line_handler,
         )
         return process.wait_result(timeout=timeout)
 
@@ -360,11 +388,14 @@ class CustomScript(Tool):
         if self.node.is_remote:
             # copy to remote
             node_script_path = self.get_tool_path()
-            for file in self._files:
-                remote_path = node_script_path.joinpath(file)
-                source_path = self._local_path.joinpath(file)
-                self.node.shell.copy(source_path, remote_path)
-                self.node.shell.chmod(remote_path, 0o755)
+            if self._builder and self.node.is_posix:
+                self._install_bundle(self._builder, node_script_path)
+            else:
+                for file in self._files:
+                    remote_path = node_script_path.joinpath(file)
+                    source_path = self._local_path.joinpath(file)
+                    self.node.shell.copy(source_path, remote_path)
+                    self.node.shell.chmod(remote_path, 0o755)
             self._cwd = node_script_path
         else:
             self._cwd = self._local_path
@@ -378,6 +409,24 @@ class CustomScript(Tool):
                 self._command = f"{self._cwd.joinpath(self._files[0])}"
         return True
 
+    def _install_bundle(
+        self, builder: CustomScriptBuilder, node_script_path: pathlib.PurePath
+    ) -> None:
+        """
+        The files are uploaded in one archive. The archive contains a marker file
+        named by the hash of file contents, so if the same files exist on the node
+        already, the upload is skipped.
+        """
+        content_hash, archive = builder.get_bundle()
+        marker_path = pathlib.PurePosixPath(node_script_path, f".{content_hash}")
+        result = self.node.execute(
+            f"test -f '{marker_path}'", shell=True, no_error_log=True
+        )
+        if result.exit_code == 0:
+            self._log.debug(f"script files exist already in '{node_script_path}'")
+        else:
+            self.node.shell.upload_archive(archive, node_script_path, log=self._log)
+
 
 class CustomScriptBuilder:
     """
@@ -431,16 +480,63 @@ class CustomScriptBuilder:
         hash_result = sha256(hash_source)
         self.name = f"custom_{command_identifier}_{hash_result.hexdigest()}".lower()
 
+        self._bundle: Optional[Tuple[str, bytes]] = None
+        self._bundle_lock = Lock()
+
     def build(self, node: Node) -> CustomScript:
         return CustomScript(
-            self.name, node, self._local_rootpath, self._files, self._command
+            self.name,
+            node,
+            self._local_rootpath,
+            self._files,
+            self._command,
+            builder=self,
         )
 
+    def get_bundle(self) -> Tuple[str, bytes]:
+        """
+        return the sha256 of file contents, and a tar.gz archive of all files. It's
+        packed once, and shared by all nodes and environments.
+        """
+        with self._bundle_lock:
+            if self._bundle is None:
+                self._bundle = self._pack()
+            return self._bundle
+
+    def _pack(self) -> Tuple[str, bytes]:
+        content_hash = sha256()
+        contents: List[Tuple[str, bytes]] = []
+        for file in self._files:
+            name = pathlib.PurePath(file).as_posix()
+            content = self._local_rootpath.joinpath(file).read_bytes()
+            content_hash.update(name.encode("utf-8") + b"\0")
+            content_hash.update(sha256(content).digest())
+            contents.append((name, content))
+        hex_hash = content_hash.hexdigest()
+
+        archive = io.BytesIO()
+        with tarfile.open(fileobj=archive, mode="w:gz") as tar:
+            for name, content in contents:
+                _add_to_tar(tar, name, content)
+            # the marker is the last one, so it exists only if all files are
+            # extracted.
+            _add_to_tar(tar, f".{hex_hash}", b"")
+        return hex_hash, archive.getvalue()
+
+
+def _add_to_tar(tar: tarfile.TarFile, name: str, content: bytes) -> None:
+    info = tarfile.TarInfo(name)
+    info.size = len(content)
+    info.mode = 0o755
+    info.mtime = int(time.time())
+    tar.addfile(info, io.BytesIO(content))
+
 
 class Tools:
     def __init__(self, node: Node) -> None:
         self._node = node
         self._cache: Dict[str, Tool] = {}
+        self._locks = KeyLocks()
 
     def __getattr__(self, key: str) -> Tool:
         """
@@ -468,43 +564,55 @@ class Tools:
             tool_key = tool_type.__name__.lower()
         tool = self._cache.get(tool_key)
         if tool is None:
-            # the Tool is not installed on current node, try to install it.
-            tool_log = get_logger("tool", tool_key, self._node.log)
-            tool_log.debug(f"initializing tool [{tool_key}]")
+            # a tool is installed once, even if it's requested by multiple threads.
+            # Other threads wait on the same key, and other tools aren't blocked.
+            with self._locks.get(tool_key):
+                tool = self._cache.get(tool_key)
+                if tool is None:
+                    tool = self._create(tool_type, tool_key)
+                    self._cache[tool_key] = tool
+        return cast(T, tool)
 
-            if isinstance(tool_type, CustomScriptBuilder):
-                tool = tool_type.build(self._node)
-            elif isinstance(tool_type, str):
-                raise LisaException(
-                    f"{tool_type} cannot be found. "
-                    f"short usage need to get with type before get with name."
-                )
-            else:
-                cast_tool_type = cast(Type[Tool], tool_type)
-                tool = cast_tool_type.create(self._node)
-
-            tool.initialize()
-
-            if not tool.exists:
-                tool_log.debug(f"'{tool.name}' not installed")
-                if tool.can_install:
-                    tool_log.debug(f"{tool.name} is installing")
-                    timer = create_timer()
-                    is_success = tool.install()
-                    if not is_success:
-                        raise LisaException(
-                            f"install '{tool.name}' failed. After installed, "
-                            f"it cannot be detected."
-                        )
-                    tool_log.debug(f"installed in {timer}")
-                else:
+    def _create(
+        self, tool_type: Union[Type[T], CustomScriptBuilder, str], tool_key: str
+    ) -> Tool:
+        # the Tool is not installed on current node, try to install it.
+        tool_log = get_logger("tool", tool_key, self._node.log)
+        tool_log.debug(f"initializing tool [{tool_key}]")
+
+        tool: Tool
+        if isinstance(tool_type, CustomScriptBuilder):
+            tool = tool_type.build(self._node)
+        elif isinstance(tool_type, str):
+            raise LisaException(
+                f"{tool_type} cannot be found. "
+                f"short usage need to get with type before get with name."
+            )
+        else:
+            cast_tool_type = cast(Type[Tool], tool_type)
+            tool = cast_tool_type.create(self._node)
+
+        tool.initialize()
+
+        if not tool.exists:
+            tool_log.debug(f"'{tool.name}' not installed")
+            if tool.can_install:
+                tool_log.debug(f"{tool.name} is installing")
+                timer = create_timer()
+                is_success = tool.install()
+                if not is_success:
                     raise LisaException(
-                        f"cannot find [{tool.name}] on [{self._node.name}], "
-                        f"{self._node.os.__class__.__name__}, "
-                        f"Remote({self._node.is_remote}) "
-                        f"and installation of [{tool.name}] isn't enabled in lisa."
+                        f"install '{tool.name}' failed. After installed, "
+                        f"it cannot be detected."
                     )
+                tool_log.debug(f"installed in {timer}")
             else:
-                tool_log.debug("installed already")
-            self._cache[tool_key] = tool
-        return cast(T, tool)
+                raise LisaException(
+                    f"cannot find [{tool.name}] on [{self._node.name}], "
+                    f"{self._node.os.__class__.__name__}, "
+                    f"Remote({self._node.is_remote}) "
+                    f"and installation of [{tool.name}] isn't enabled in lisa."
+                )
+        else:
+            tool_log.debug("installed already")
+        return tool
@@ -4,7 +4,7 @@
 from abc import abstractmethod
 from typing import TYPE_CHECKING, Any, Dict, Optional, Type, TypeVar, cast
 
-from lisa.util import InitializableMixin, LisaException
+from lisa.util import InitializableMixin, KeyLocks, LisaException
 from lisa.util.logger import get_logger
 
 if TYPE_CHECKING:
@@ -48,6 +48,7 @@ class Features:
         self._node: Node = node
         self._platform: Platform = platform
         self._cache: Dict[str, Feature] = {}
+        self._locks = KeyLocks()
         self._supported_features: Dict[str, Type[Feature]] = {}
         for feature_type in platform.supported_features():
             self._supported_features[feature_type.name()] = feature_type
@@ -56,15 +57,19 @@ class Features:
         feature_name = feature_type.name()
         feature: Optional[Feature] = self._cache.get(feature_name, None)
         if feature is None:
-            registered_feature_type = self._supported_features.get(feature_name)
-            if not registered_feature_type:
-                raise LisaException(
-                    f"feature [{feature_name}] isn't supported on "
-                    f"platform [{self._platform.type_name()}]"
-                )
-            feature = registered_feature_type(self._node, self._platform)
-            feature.initialize()
-            self._cache[feature_type.name()] = feature
+            # create it once, if it's requested by multiple threads.
+            with self._locks.get(feature_name):
+                feature = self._cache.get(feature_name, None)
+                if feature is None:
+                    registered_feature_type = self._supported_features.get(feature_name)
+                    if not registered_feature_type:
+                        raise LisaException(
+                            f"feature [{feature_name}] isn't supported on "
+                            f"platform [{self._platform.type_name()}]"
+                        )
+                    feature = registered_feature_type(self._node, self._platform)
+                    feature.initialize()
+                    self._cache[feature_name] = feature
 
         assert feature
         return cast(T_FEATURE, feature)
@@ -3,9 +3,22 @@
 
 from __future__ import annotations
 
+import asyncio
+from functools import partial
 from pathlib import Path, PurePath, PurePosixPath, PureWindowsPath
 from random import randint
-from typing import Any, Dict, Iterable, List, Optional, Type, TypeVar, Union, cast
+from typing import (
+    Any,
+    Callable,
+    Dict,
+    Iterable,
+    List,
+    Optional,
+    Type,
+    TypeVar,
+    Union,
+    cast,
+)
 
 from lisa import schema
 from lisa.executable import Tools
@@ -21,8 +34,16 @@ from lisa.util import (
     subclasses,
 )
 from lisa.util.logger import get_logger
-from lisa.util.process import ExecutableResult, Process
-from lisa.util.shell import ConnectionInfo, LocalShell, Shell, SshShell
+from lisa.util.parallel import run_in_parallel
+from lisa.util.process import CommandBatch, ExecutableResult, Process
+from lisa.util.shell import (
+    DEFAULT_MAX_CHANNELS,
+    ConnectionInfo,
+    LocalShell,
+    Shell,
+    SshShell,
+    create_ssh_shell,
+)
 
 T = TypeVar("T")
 
@@ -59,6 +80,9 @@ class Node(subclasses.BaseClassWithRunbookMixin, ContextMixin, InitializableMixi
         # contains node name, which is not set in __init__.
         self._local_log_path: Optional[Path] = None
         self._support_sudo: Optional[bool] = None
+        # it's increased, when information like the kernel version may be
+        # changed. So the environment information is queried again.
+        self.information_generation: int = 0
 
     @property
     def shell(self) -> Shell:
@@ -160,6 +184,9 @@ class Node(subclasses.BaseClassWithRunbookMixin, ContextMixin, InitializableMixi
     def reboot(self) -> None:
         self.tools[Reboot].reboot()
 
+    def mark_information_changed(self) -> None:
+        self.information_generation += 1
+
     def execute(
         self,
         cmd: str,
@@ -169,6 +196,7 @@ class Node(subclasses.BaseClassWithRunbookMixin, ContextMixin, InitializableMixi
         no_info_log: bool = True,
         cwd: Optional[PurePath] = None,
         timeout: int = 600,
+        line_handler: Optional[Callable[[str], None]] = None,
     ) -> ExecutableResult:
         process = self.execute_async(
             cmd,
@@ -177,9 +205,52 @@ class Node(subclasses.BaseClassWithRunbookMixin, ContextMixin, InitializableMixi
             no_error_log=no_error_log,
             no_info_log=no_info_log,
             cwd=cwd,
+            line_handler=line_handler,
         )
         return process.wait_result(timeout=timeout)
 
+    def execute_batch(
+        self,
+        commands: List[str],
+        sudo: bool = False,
+        no_error_log: bool = False,
+        no_info_log: bool = True,
+        cwd: Optional[PurePath] = None,
+        timeout: int = 600,
+    ) -> List[ExecutableResult]:
+        """
+        Run independent commands in one round trip, and return a result for each
+        command. Commands run in shell one by one, and later commands run even if
+        earlier ones fail. The timeout is for all commands.
+        """
+        self.initialize()
+        if not self.shell.is_posix:
+            # the batch script needs a posix shell.
+            return [
+                self.execute(
+                    command,
+                    shell=True,
+                    sudo=sudo,
+                    no_error_log=no_error_log,
+                    no_info_log=no_info_log,
+                    cwd=cwd,
+                    timeout=timeout,
+                )
+                for command in commands
+            ]
+
+        batch = CommandBatch(commands)
+        result = self.execute(
+            batch.script,
+            shell=True,
+            sudo=sudo,
+            no_error_log=no_error_log,
+            no_info_log=no_info_log,
+            cwd=cwd,
+            timeout=timeout,
+        )
+        return batch.parse(result)
+
     def execute_async(
         self,
         cmd: str,
@@ -188,7 +259,19 @@ class Node(subclasses.BaseClassWithRunbookMixin, ContextMixin, InitializableMixi
         no_error_log: bool = False,
         no_info_log: bool = True,
         cwd: Optional[PurePath] = None,
+        line_handler: Optional[Callable[[str], None]] = None,
     ) -> Process:
+        """
+        The returned process can be waited by wait_result, or awaited in asyncio.
+        The command is spawned in the calling thread, and it may block on
+        connecting. In a running loop, it doesn't wait for a free channel, and the
+        command is spawned, when it's awaited. execute_in_loop doesn't block the
+        loop at all.
+
+        line_handler: it enables the streaming mode. Each line of stdout is passed
+            to it, when the line is received. If the output is large, it's saved to
+            the log path of the node, instead of keeping in memory.
+        """
         self.initialize()
 
         if sudo and not self.support_sudo:
@@ -203,7 +286,47 @@ class Node(subclasses.BaseClassWithRunbookMixin, ContextMixin, InitializableMixi
             no_error_log=no_error_log,
             no_info_log=no_info_log,
             cwd=cwd,
+            line_handler=line_handler,
+        )
+
+    async def execute_in_loop(
+        self,
+        cmd: str,
+        shell: bool = False,
+        sudo: bool = False,
+        no_error_log: bool = False,
+        no_info_log: bool = True,
+        cwd: Optional[PurePath] = None,
+        timeout: int = 600,
+        line_handler: Optional[Callable[[str], None]] = None,
+    ) -> ExecutableResult:
+        """
+        The coroutine version of execute. Connecting and spawning run in threads of
+        the loop executor, and free channels are waited in the loop, so the loop
+        isn't blocked, and threads don't wait for channels. Commands on many nodes,
+        or more commands than channels on one node, can run in one loop, like
+        "await asyncio.gather(*[x.execute_in_loop(cmd) for x in nodes])".
+        """
+        loop = asyncio.get_running_loop()
+        await loop.run_in_executor(None, self.initialize)
+
+        if sudo and not self.support_sudo:
+            raise LisaException(
+                f"node doesn't support [command] or [sudo], cannot execute: {cmd}"
+            )
+
+        process = self._create_process()
+        await process.start_async(
+            cmd,
+            shell=shell,
+            sudo=sudo,
+            no_error_log=no_error_log,
+            no_info_log=no_info_log,
+            cwd=cwd,
+            line_handler=line_handler,
+            spill_path=self.local_log_path if line_handler else None,
         )
+        return await process.wait_result_async(timeout=timeout)
 
     def close(self) -> None:
         self.log.debug("closing node connection...")
@@ -214,6 +337,9 @@ class Node(subclasses.BaseClassWithRunbookMixin, ContextMixin, InitializableMixi
         self.log.info(f"initializing node '{self.name}' {self}")
         self.shell.initialize()
         self.os: OperatingSystem = OperatingSystem.create(self)
+        # the information, which is collected before connecting, misses the
+        # information of the node.
+        self.mark_information_changed()
 
     def _execute(
         self,
@@ -223,9 +349,9 @@ class Node(subclasses.BaseClassWithRunbookMixin, ContextMixin, InitializableMixi
         no_error_log: bool = False,
         no_info_log: bool = False,
         cwd: Optional[PurePath] = None,
+        line_handler: Optional[Callable[[str], None]] = None,
     ) -> Process:
-        cmd_id = str(randint(0, 10000))
-        process = Process(cmd_id, self.shell, parent_logger=self.log)
+        process = self._create_process()
         process.start(
             cmd,
             shell=shell,
@@ -233,9 +359,15 @@ class Node(subclasses.BaseClassWithRunbookMixin, ContextMixin, InitializableMixi
             no_error_log=no_error_log,
             no_info_log=no_info_log,
             cwd=cwd,
+            line_handler=line_handler,
+            spill_path=self.local_log_path if line_handler else None,
         )
         return process
 
+    def _create_process(self) -> Process:
+        cmd_id = str(randint(0, 10000))
+        return Process(cmd_id, self.shell, parent_logger=self.log)
+
     def _create_working_path(self) -> PurePath:
         raise NotImplementedError()
 
@@ -281,6 +413,10 @@ class RemoteNode(Node):
             constants.ENVIRONMENTS_NODES_REMOTE_PORT,
             constants.ENVIRONMENTS_NODES_REMOTE_PUBLIC_ADDRESS,
             constants.ENVIRONMENTS_NODES_REMOTE_PUBLIC_PORT,
+            constants.ENVIRONMENTS_NODES_REMOTE_MAX_CHANNELS,
+            constants.ENVIRONMENTS_NODES_REMOTE_USE_SESSION,
+            constants.ENVIRONMENTS_NODES_REMOTE_USE_AGENT,
+            constants.ENVIRONMENTS_NODES_REMOTE_SHELL_BACKEND,
         ]
         parameters = fields_to_dict(self.runbook, fields)
 
@@ -309,6 +445,10 @@ class RemoteNode(Node):
         username: str = "root",
         password: str = "",
         private_key_file: str = "",
+        max_channels: int = DEFAULT_MAX_CHANNELS,
+        use_session: bool = False,
+        use_agent: bool = False,
+        shell_backend: str = constants.SHELL_BACKEND_SPUR,
     ) -> None:
         if hasattr(self, "_connection_info"):
             raise LisaException(
@@ -340,8 +480,12 @@ class RemoteNode(Node):
             username,
             password,
             private_key_file,
+            max_channels,
+            use_session,
+            use_agent,
+            shell_backend,
         )
-        self._shell = SshShell(self._connection_info)
+        self._shell = create_ssh_shell(self._connection_info)
 
         self.public_address = public_address
         self.public_port = public_port
@@ -351,6 +495,16 @@ class RemoteNode(Node):
     def _initialize(self, *args: Any, **kwargs: Any) -> None:
         assert self._connection_info, "call setConnectionInfo before use remote node"
         super()._initialize(*args, **kwargs)
+        if self._connection_info.use_agent and self.is_posix:
+            self._start_agent()
+
+    def _start_agent(self) -> None:
+        assert isinstance(self.shell, SshShell)
+        try:
+            self.shell.start_agent(self.working_path)
+        except Exception as identifier:
+            # commands still work without the agent.
+            self.log.info(f"failed to start agent, run commands by SSH: {identifier}")
 
     def _create_working_path(self) -> PurePath:
         if self.is_posix:
@@ -415,6 +569,9 @@ class Nodes:
         super().__init__()
         self._default: Optional[Node] = None
         self._list: List[Node] = []
+        # it's increased when nodes are added, so the environment knows its
+        # capability is changed.
+        self.generation: int = 0
 
     def __getitem__(self, key: Union[int, str]) -> Node:
         found = None
@@ -460,13 +617,69 @@ class Nodes:
         for node in self._list:
             yield node
 
+    @property
+    def tools_all(self) -> NodesTools:
+        """
+        Get a tool on all nodes, and install it in parallel, if it's needed.
+        """
+        return NodesTools(self)
+
     def initialize(self) -> None:
-        for node in self._list:
-            node.initialize()
+        self.run_all(lambda node: node.initialize())
 
     def close(self) -> None:
-        for node in self._list:
-            node.close()
+        self.run_all(lambda node: node.close())
+
+    def execute_all(
+        self,
+        cmd: str,
+        shell: bool = False,
+        sudo: bool = False,
+        no_error_log: bool = False,
+        no_info_log: bool = True,
+        cwd: Optional[PurePath] = None,
+        timeout: int = 600,
+    ) -> List[ExecutableResult]:
+        """
+        Run the command on all nodes in parallel, and return results in the order
+        of nodes.
+        """
+        return self.run_all(
+            lambda node: node.execute(
+                cmd,
+                shell=shell,
+                sudo=sudo,
+                no_error_log=no_error_log,
+                no_info_log=no_info_log,
+                cwd=cwd,
+                timeout=timeout,
+            )
+        )
+
+    def copy_back_all(self, node_path: PurePath, local_path: Path) -> List[Path]:
+        """
+        Download the file or folder from all nodes in parallel. The copy of each
+        node is saved under a sub folder of the node name, and paths are returned
+        in the order of nodes.
+        """
+
+        def _copy_back(node: Node) -> Path:
+            node_local_path = local_path / str(node.name or node.index) / node_path.name
+            node.shell.copy_back(node_path, node_local_path, log=node.log)
+            return node_local_path
+
+        return self.run_all(_copy_back)
+
+    def run_all(self, method: Callable[[Node], T]) -> List[T]:
+        """
+        Call the method on all nodes in parallel. If it fails on any node, a
+        ParallelException is raised with exceptions of each failed node, after
+        all nodes are completed.
+        """
+        return run_in_parallel(
+            [partial(method, node) for node in self._list],
+            names=[f"node '{node.name or node.index}'" for node in self._list],
+        )
 
     def from_existing(
         self,
@@ -481,6 +694,7 @@ class Nodes:
             base_log_path=base_log_path,
         )
         self._list.append(node)
+        self.generation += 1
 
         return node
 
@@ -512,5 +726,14 @@ class Nodes:
             base_log_path=base_log_path,
         )
         self._list.append(node)
+        self.generation += 1
 
         return node
+
+
+class NodesTools:
+    def __init__(self, nodes: Nodes) -> None:
+        self._nodes = nodes
+
+    def __getitem__(self, tool_type: Type[T]) -> List[T]:
+        return self._nodes.run_all(lambda node: node.tools[tool_type])
@@ -37,6 +37,9 @@ class TestRunMessage(MessageBase):
     tags: Optional[List[str]] = None
     run_name: str = ""
     message: str = ""
+    # it is used to merge results of shards, which run in different processes.
+    shard_index: int = 0
+    shard_count: int = 1
 
 
 class Notifier(subclasses.BaseClassWithRunbookMixin, InitializableMixin):
@@ -143,46 +143,51 @@ class OperatingSystem:
     @classmethod
     def _get_detect_string(cls, node: Any) -> Iterable[str]:
         typed_node: Node = node
-        cmd_result = typed_node.execute(cmd="lsb_release -d", no_error_log=True)
-        yield get_matched_str(cmd_result.stdout, cls.__lsb_release_pattern)
-
-        cmd_result = typed_node.execute(cmd="cat /etc/os-release", no_error_log=True)
-        yield get_matched_str(cmd_result.stdout, cls.__os_release_pattern_name)
-        yield get_matched_str(cmd_result.stdout, cls.__os_release_pattern_id)
-        cmd_result_os_release = cmd_result
-
-        # for RedHat, CentOS 6.x
-        cmd_result = typed_node.execute(
-            cmd="cat /etc/redhat-release", no_error_log=True
+        # note, cat /etc/*release doesn't work in some images, so try them one by
+        # one. They are sent in a batch to save round trips.
+        (
+            lsb_release,
+            os_release,
+            redhat_release,
+            uname,
+            issue,
+            release,
+            lsb_release_file,
+            suse_release,
+        ) = typed_node.execute_batch(
+            [
+                "lsb_release -d",
+                "cat /etc/os-release",
+                # for RedHat, CentOS 6.x
+                "cat /etc/redhat-release",
+                # for FreeBSD
+                "uname",
+                # for Debian
+                "cat /etc/issue",
+                # try best for other distros, like Sapphire
+                "cat /etc/release",
+                # try best for other distros, like VeloCloud
+                "cat /etc/lsb-release",
+                # try best for some suse derives, like netiq
+                "cat /etc/SuSE-release",
+            ],
+            no_error_log=True,
         )
-        yield get_matched_str(cmd_result.stdout, cls.__redhat_release_pattern_header)
-        yield get_matched_str(cmd_result.stdout, _redhat_release_pattern_bracket)
-
-        # for FreeBSD
-        cmd_result = typed_node.execute(cmd="uname", no_error_log=True)
-        yield cmd_result.stdout
-
-        # for Debian
-        cmd_result = typed_node.execute(cmd="cat /etc/issue", no_error_log=True)
-        yield get_matched_str(cmd_result.stdout, cls.__debian_issue_pattern)
-
-        # note, cat /etc/*release doesn't work in some images, so try them one by one
-        # try best for other distros, like Sapphire
-        cmd_result = typed_node.execute(cmd="cat /etc/release", no_error_log=True)
-        yield get_matched_str(cmd_result.stdout, cls.__release_pattern)
-
-        # try best for other distros, like VeloCloud
-        cmd_result = typed_node.execute(cmd="cat /etc/lsb-release", no_error_log=True)
-        yield get_matched_str(cmd_result.stdout, cls.__release_pattern)
-
-        # try best for some suse derives, like netiq
-        cmd_result = typed_node.execute(cmd="cat /etc/SuSE-release", no_error_log=True)
-        yield get_matched_str(cmd_result.stdout, cls.__suse_release_pattern)
-
-        # try best from distros'family through ID_LIKE
+        yield get_matched_str(lsb_release.stdout, cls.__lsb_release_pattern)
+        yield get_matched_str(os_release.stdout, cls.__os_release_pattern_name)
+        yield get_matched_str(os_release.stdout, cls.__os_release_pattern_id)
         yield get_matched_str(
-            cmd_result_os_release.stdout, cls.__os_release_pattern_idlike
+            redhat_release.stdout, cls.__redhat_release_pattern_header
         )
+        yield get_matched_str(redhat_release.stdout, _redhat_release_pattern_bracket)
+        yield uname.stdout
+        yield get_matched_str(issue.stdout, cls.__debian_issue_pattern)
+        yield get_matched_str(release.stdout, cls.__release_pattern)
+        yield get_matched_str(lsb_release_file.stdout, cls.__release_pattern)
+        yield get_matched_str(suse_release.stdout, cls.__suse_release_pattern)
+
+        # try best from distros'family through ID_LIKE
+        yield get_matched_str(os_release.stdout, cls.__os_release_pattern_idlike)
 
     def _get_os_version(self) -> OsVersion:
         raise NotImplementedError
@@ -245,6 +250,8 @@ class Posix(OperatingSystem, BaseClassMixin):
     # In most of the distros, the text in the brackets is the codename.
     # This regex gets the codename for the ditsro
     __distro_codename_pattern = re.compile(r"^.*\(([^)]+)")
+    # kernel packages of distros, like kernel, kernel-devel and linux-image-azure.
+    __kernel_package_pattern = re.compile(r"^(kernel|linux-image)")
 
     def __init__(self, node: Any) -> None:
         super().__init__(node, is_posix=True)
@@ -377,6 +384,8 @@ class Posix(OperatingSystem, BaseClassMixin):
     ) -> None:
         package_names = self._get_package_list(packages)
         self._install_packages(package_names, signed)
+        if any(self.__kernel_package_pattern.match(x) for x in package_names):
+            self._node.mark_information_changed()
 
     def package_exists(
         self, package: Union[str, Tool, Type[Tool]], signed: bool = True
@@ -393,6 +402,8 @@ class Posix(OperatingSystem, BaseClassMixin):
     ) -> None:
         package_names = self._get_package_list(packages)
         self._update_packages(package_names)
+        # the kernel may be updated.
+        self._node.mark_information_changed()
 
     def __resolve_package_name(self, package: Union[str, Tool, Type[Tool]]) -> str:
         """
@@ -45,12 +45,41 @@ def support_variable(parser: ArgumentParser) -> None:
     )
 
 
+def support_shard(parser: ArgumentParser) -> None:
+    parser.add_argument(
+        "--shard-index",
+        dest="shard_index",
+        type=int,
+        help="The index of shard to run, it starts from 0. It overwrites the "
+        "shard_index in runbook.",
+    )
+    parser.add_argument(
+        "--shard-count",
+        dest="shard_count",
+        type=int,
+        help="Split selected test cases into shards, so they can run in multiple "
+        "processes or hosts. It overwrites the shard_count in runbook.",
+    )
+
+
+def support_resume(parser: ArgumentParser) -> None:
+    parser.add_argument(
+        "--resume",
+        dest="resume",
+        help="The run path of an interrupted run. Completed cases in its "
+        "checkpoints are not run again, and surviving environments are reused. "
+        "The runbook and variables should be the same as the interrupted run.",
+    )
+
+
 def parse_args() -> Namespace:
     """This wraps Python's 'ArgumentParser' to setup our CLI."""
     parser = ArgumentParser(prog="lisa")
     support_debug(parser)
     support_runbook(parser, required=False)
     support_variable(parser)
+    support_shard(parser)
+    support_resume(parser)
 
     # Default to ‘run’ when no subcommand is given.
     parser.set_defaults(func=commands.run)
@@ -60,6 +89,33 @@ def parse_args() -> Namespace:
     # Entry point for ‘run’.
     run_parser = subparsers.add_parser("run")
     run_parser.set_defaults(func=commands.run)
+    support_shard(run_parser)
+    support_resume(run_parser)
+
+    # Entry point for ‘simulate’.
+    simulate_parser = subparsers.add_parser("simulate")
+    simulate_parser.set_defaults(func=commands.simulate)
+    support_shard(simulate_parser)
+    simulate_parser.add_argument(
+        "--concurrency",
+        dest="concurrency",
+        type=int,
+        nargs="+",
+        help="Concurrency settings to simulate, each one is simulated separately. "
+        "The concurrency in runbook is used, if it's not specified.",
+    )
+    for name, description in [
+        ("deploy-time", "deploying an environment"),
+        ("initialize-time", "initializing an environment"),
+        ("case-time", "running a test case, if it has no history"),
+        ("delete-time", "deleting an environment"),
+    ]:
+        simulate_parser.add_argument(
+            f"--{name}",
+            dest=name.replace("-", "_"),
+            type=float,
+            help=f"The modeled seconds of {description}.",
+        )
 
     # Entry point for ‘list-start’.
     list_parser = subparsers.add_parser(constants.LIST)
@@ -6,7 +6,7 @@ from __future__ import annotations
 from dataclasses import dataclass
 from enum import Enum
 from functools import partial
-from typing import Any, Dict, List, Type, cast
+from typing import Any, Callable, Dict, List, Type, cast
 
 from lisa import schema
 from lisa.environment import Environment, EnvironmentStatus
@@ -14,6 +14,7 @@ from lisa.feature import Feature, Features
 from lisa.node import RemoteNode
 from lisa.notifier import MessageBase
 from lisa.parameter_parser.runbook import RunbookBuilder
+from lisa.testsuite import TestResult
 from lisa.util import (
     InitializableMixin,
     LisaException,
@@ -97,6 +98,57 @@ class Platform(subclasses.BaseClassWithRunbookMixin, InitializableMixin):
     def _get_environment_information(self, environment: Environment) -> Dict[str, str]:
         return {}
 
+    def _get_environment_checkpoint(self, environment: Environment) -> Dict[str, Any]:
+        """
+        platform specified information, which is saved in the checkpoint, so the
+        deployed environment can be found on resuming.
+        """
+        return {}
+
+    def _restore_environment(
+        self, environment: Environment, context: Dict[str, Any], log: Logger
+    ) -> bool:
+        """
+        Find the deployed environment by the information of checkpoint, and fill
+        nodes like deployment.
+
+        return True, if the environment is restored. False, if it's not supported
+        or the environment doesn't exist anymore, so it needs to be deployed again.
+        """
+        return False
+
+    def _initialize_environment(self, environment: Environment, log: Logger) -> None:
+        """
+        Connect nodes of the deployed environment. A platform, which doesn't touch
+        nodes, can override it.
+        """
+        environment.initialize()
+
+    def _run_test_results(
+        self,
+        environment: Environment,
+        test_results: List[TestResult],
+        run: Callable[[], None],
+        log: Logger,
+    ) -> None:
+        """
+        run: it runs test cases on the environment. A platform, which doesn't run
+            cases, can override it.
+        """
+        run()
+
+    def get_duration_history_type(self) -> str:
+        """
+        The platform type, which durations of test cases are loaded for.
+        """
+        return self.type_name()
+
+    def is_duration_history_saved(self) -> bool:
+        """
+        False, if durations of test cases are not real, so they are not saved.
+        """
+        return True
+
     @hookimpl
     def get_environment_information(self, environment: Environment) -> Dict[str, str]:
         information: Dict[str, str] = {}
@@ -163,6 +215,38 @@ class Platform(subclasses.BaseClassWithRunbookMixin, InitializableMixin):
             node.features = Features(node, self)
         log.info(f"deployed in {timer}")
 
+    def initialize_environment(self, environment: Environment) -> None:
+        log = get_logger(f"init[{environment.name}]", parent=self._log)
+        self._initialize_environment(environment, log)
+
+    def run_test_results(
+        self,
+        environment: Environment,
+        test_results: List[TestResult],
+        run: Callable[[], None],
+    ) -> None:
+        log = get_logger(f"run[{environment.name}]", parent=self._log)
+        self._run_test_results(environment, test_results, run, log)
+
+    def get_environment_checkpoint(self, environment: Environment) -> Dict[str, Any]:
+        return self._get_environment_checkpoint(environment)
+
+    def restore_environment(
+        self, environment: Environment, context: Dict[str, Any]
+    ) -> bool:
+        log = get_logger(f"restore[{environment.name}]", parent=self._log)
+        environment.platform = self
+        is_success = self._restore_environment(environment, context, log)
+        if not is_success:
+            log.info("cannot restore environment, it will be deployed again.")
+            return False
+        environment.status = EnvironmentStatus.Deployed
+
+        for node in environment.nodes.list():
+            node.features = Features(node, self)
+        log.info("restored environment from checkpoint")
+        return True
+
     def delete_environment(self, environment: Environment) -> None:
         log = get_logger(f"del[{environment.name}]", parent=self._log)
         log.debug("deleting")
@@ -2,6 +2,7 @@
 # Licensed under the MIT license.
 
 import copy
+from concurrent.futures import Future
 from logging import FileHandler
 from threading import Lock
 from typing import Any, Callable, Dict, Iterator, List, Optional
@@ -67,6 +68,14 @@ class BaseRunner(BaseClassMixin, InitializableMixin):
         """
         raise NotImplementedError()
 
+    def get_waiting_futures(self) -> List["Future[Any]"]:
+        """
+        It's called, when the runner has no task. The runner is asked again, once
+        one of the futures is completed, like deployments ahead in its own pool.
+        So waiting for them doesn't use a worker.
+        """
+        return []
+
     def close(self) -> None:
         if self._log_handler:
             remove_handler(self._log_handler)
@@ -232,6 +241,40 @@ class RootRunner(Action):
         finally:
             self._results_lock.release()
 
+    def _submit_tasks(
+        self,
+        task_manager: TaskManager[List[TestResult]],
+        pending_runners: List[BaseRunner],
+        remaining_runners: List[BaseRunner],
+    ) -> None:
+        while pending_runners and task_manager.has_idle_worker():
+            runner = pending_runners[0]
+            task = None if runner.is_done else runner.fetch_task()
+            if task:
+                self._log.debug(f"fetched task from {runner.id}: '{task}'")
+                task_manager.submit_task(task, owner=runner)
+                # keep asking the same runner, until it has no task or no idle
+                # worker. The stopped runner keeps first in the pending list, so
+                # it's asked firstly in next pass.
+                continue
+
+            # current runner may not be done, but it doesn't have task
+            # temporarily. It's asked again, once its task or a future it waits
+            # for is completed.
+            pending_runners.pop(0)
+            for future in runner.get_waiting_futures():
+                task_manager.watch_future(future, owner=runner)
+            if runner.is_done:
+                # runners shouldn't mark them done, until all task completed. It
+                # can be checked by test results status or other signals. Remove
+                # fully completed runner.
+                runner.close()
+                remaining_runners.remove(runner)
+                self._log.debug(
+                    f"runner '{runner.id}' is done, "
+                    f"remaining runners {[x.id for x in remaining_runners]}"
+                )
+
     def _start_loop(self) -> None:
         # in case all of runners are disabled
         runner_iterator = self._fetch_runners()
@@ -255,48 +298,28 @@ class RootRunner(Action):
             set_global_task_manager(task_manager)
             has_more_runner = True
 
-            # run until no more task and all runner are closed
-            while task_manager.wait_worker() or remaining_runners:
-                assert task_manager.has_idle_worker()
-                has_idle_worker = True
-
-                # runners shouldn't mark them done, until all task completed. It
-                # can be checked by test results status or other signals.
-                assert remaining_runners, (
-                    f"no remaining runners, but there are running tasks. "
-                    f"{task_manager._futures}"
-                )
+            # Runners may have tasks to schedule. A runner's state is changed by
+            # its own tasks only, so only new runners, owners of completed tasks,
+            # and runners stopped by no idle worker need to be asked again.
+            pending_runners: List[BaseRunner] = remaining_runners.copy()
 
-                for runner in remaining_runners:
-                    while not runner.is_done:
-                        # fetch a task and submit
-                        task = runner.fetch_task()
-                        if task:
-                            self._log.debug(f"fetched task from {runner.id}: '{task}'")
-                            task_manager.submit_task(task)
-                        else:
-                            # current runner may not be done, but it doesn't
-                            # have task temporialy. The root runner can start
-                            # tasks from next runner.
-                            break
-                        if not task_manager.has_idle_worker():
-                            has_idle_worker = False
-                            break
-                    if runner.is_done:
-                        # remove fully completed runner.
-                        runner.close()
-                        remaining_runners.remove(runner)
-                        self._log.debug(
-                            f"runner '{runner.id}' is done, "
-                            f"remaining runners {[x.id for x in remaining_runners]}"
-                        )
-                        break
-                    if not has_idle_worker:
-                        # uses the result from previous runner, because the
-                        # worker status may be changed after first runner
-                        # finished. Evne in this case, it should try result from
-                        # previous runner firstly in next run.
-                        break
+            # run until no more task and all runner are closed
+            while remaining_runners or task_manager.has_running_task:
+                if task_manager.has_running_task and (
+                    not pending_runners or not task_manager.has_idle_worker()
+                ):
+                    for runner in task_manager.wait_completed():
+                        if (
+                            runner in remaining_runners
+                            and runner not in pending_runners
+                        ):
+                            pending_runners.append(runner)
+                elif not pending_runners:
+                    # no task is running, so no completion can wake up any
+                    # runner. Ask all runners again.
+                    pending_runners = remaining_runners.copy()
+
+                self._submit_tasks(task_manager, pending_runners, remaining_runners)
 
                 while (
                     len(remaining_runners) < self._max_concurrency and has_more_runner
@@ -304,6 +327,15 @@ class RootRunner(Action):
                     # Fetch runners, if runner count is smaller than concurrency
                     # count. It makes sure all concurrency can run.
                     try:
-                        remaining_runners.append(next(runner_iterator))
+                        new_runner = next(runner_iterator)
+                        remaining_runners.append(new_runner)
+                        pending_runners.append(new_runner)
                     except StopIteration:
                         has_more_runner = False
+
+            self._log.debug(
+                f"scheduler passes: {task_manager.scheduler_passes}, "
+                f"overhead: {task_manager.scheduler_overhead:.3f} sec, "
+                f"average: {task_manager.average_scheduler_overhead * 1000:.3f} ms "
+                f"per pass"
+            )
@@ -0,0 +1,186 @@
+# Copyright (c) Microsoft Corporation.
+# Licensed under the MIT license.
+
+import json
+import threading
+from dataclasses import dataclass, field
+from pathlib import Path
+from typing import Any, Callable, Dict, List, Optional
+
+from dataclasses_json import dataclass_json
+
+from lisa.environment import Environment, EnvironmentStatus
+from lisa.testsuite import TestResult, TestStatus
+from lisa.util import constants
+from lisa.util.logger import Logger
+from lisa.util.perf_timer import Timer, create_timer
+
+CHECKPOINT_FOLDER = "checkpoints"
+
+# the checkpoint is saved at most once in the interval, except the final one.
+_save_interval = 10
+
+
+@dataclass_json()
+@dataclass
+class EnvironmentCheckpoint:
+    name: str = ""
+    status: str = ""
+    platform: str = ""
+    is_new: bool = True
+    # platform specified information to find the environment again, like the
+    # resource group name on Azure.
+    context: Dict[str, Any] = field(default_factory=dict)
+
+
+@dataclass_json()
+@dataclass
+class ResultCheckpoint:
+    id_: str = ""
+    name: str = ""
+    status: str = ""
+    elapsed: float = 0
+    message: str = ""
+
+
+@dataclass_json()
+@dataclass
+class RunnerCheckpoint:
+    runner_id: str = ""
+    run_name: str = ""
+    results: List[ResultCheckpoint] = field(default_factory=list)
+    environments: List[EnvironmentCheckpoint] = field(default_factory=list)
+
+    def get_completed_results(self) -> Dict[str, ResultCheckpoint]:
+        completed_names = {
+            x.name
+            for x in [
+                TestStatus.FAILED,
+                TestStatus.PASSED,
+                TestStatus.SKIPPED,
+                TestStatus.ATTEMPTED,
+            ]
+        }
+        return {x.id_: x for x in self.results if x.status in completed_names}
+
+    def get_alive_environments(self) -> Dict[str, EnvironmentCheckpoint]:
+        alive_names = {
+            x.name for x in [EnvironmentStatus.Deployed, EnvironmentStatus.Connected]
+        }
+        return {x.name: x for x in self.environments if x.status in alive_names}
+
+
+def create_result_checkpoint(test_result: TestResult) -> ResultCheckpoint:
+    return ResultCheckpoint(
+        id_=test_result.id_,
+        name=test_result.runtime_data.metadata.full_name,
+        status=test_result.status.name,
+        elapsed=test_result.elapsed,
+        message=test_result.message,
+    )
+
+
+def create_environment_checkpoint(
+    environment: Environment, context: Dict[str, Any]
+) -> EnvironmentCheckpoint:
+    # nodes are connected again by the platform from the context, so they are
+    # not saved.
+    return EnvironmentCheckpoint(
+        name=environment.name,
+        status=environment.status.name,
+        platform=environment.platform.type_name() if environment.platform else "",
+        is_new=environment.is_new,
+        context=context,
+    )
+
+
+def get_checkpoint_path(run_path: Path, runner_id: str) -> Path:
+    return run_path / CHECKPOINT_FOLDER / f"{runner_id}.json"
+
+
+def load_checkpoint(path: Path, log: Logger) -> Optional[RunnerCheckpoint]:
+    if not path.exists():
+        log.info(f"no checkpoint found at '{path}', all cases will run.")
+        return None
+    with open(path, "r") as f:
+        raw_data: Dict[str, Any] = json.load(f)
+    checkpoint: RunnerCheckpoint = RunnerCheckpoint.schema().load(  # type: ignore
+        raw_data
+    )
+    return checkpoint
+
+
+class CheckpointWriter:
+    """
+    It saves the checkpoint of a runner to the run folder, so the run can be
+    resumed, if it's interrupted. The checkpoint is saved only when it's
+    changed, and not more than once in an interval.
+
+    The version is a cheap summary of the state, which changes with the
+    checkpoint. Callers check is_due before building the checkpoint, because
+    building it may call platforms for each environment. A change in the
+    interval is saved by a pending timer, once the interval passes. So the last
+    change before a long case is not lost, if the run is interrupted in it.
+    """
+
+    def __init__(self, path: Path) -> None:
+        self.path = path
+        self._last_version: Any = None
+        self._timer: Optional[Timer] = None
+        self._pending: Optional[threading.Timer] = None
+        self._pending_lock = threading.Lock()
+
+    def is_changed(self, version: Any) -> bool:
+        return bool(version != self._last_version)
+
+    def is_due(self, version: Any, force: bool = False) -> bool:
+        if not self.is_changed(version):
+            return False
+        return (
+            force or self._timer is None or self._timer.elapsed(False) >= _save_interval
+        )
+
+    def save(self, checkpoint: RunnerCheckpoint, version: Any) -> None:
+        raw_data: Dict[str, Any] = checkpoint.to_dict()  # type: ignore
+        self.path.parent.mkdir(parents=True, exist_ok=True)
+        # write to a temp file and replace, so a broken file won't be left, if the
+        # run is killed on saving.
+        temp_path = self.path.with_suffix(".tmp")
+        with open(temp_path, "w") as f:
+            json.dump(raw_data, f, indent=2)
+        temp_path.replace(self.path)
+        self._last_version = version
+        self._timer = create_timer()
+        self.cancel_pending()
+
+    def schedule(self, save: Callable[[], None]) -> None:
+        """
+        It's called, when a changed checkpoint is not due. save is called once
+        the interval passes, and it's called once for changes in the interval.
+        """
+        with self._pending_lock:
+            if self._pending or self._timer is None:
+                return
+            delay = max(_save_interval - self._timer.elapsed(False), 0)
+            self._pending = threading.Timer(delay, self._save_pending, args=(save,))
+            self._pending.daemon = True
+            self._pending.start()
+
+    def cancel_pending(self) -> None:
+        with self._pending_lock:
+            if self._pending:
+                self._pending.cancel()
+                self._pending = None
+
+    def _save_pending(self, save: Callable[[], None]) -> None:
+        with self._pending_lock:
+            self._pending = None
+        save()
+
+
+def create_checkpoint_writer(runner_id: str) -> Optional[CheckpointWriter]:
+    # the run path is set by the main entry. It's not set in unit tests, so the
+    # checkpoint is not saved.
+    if constants.RUN_LOCAL_PATH == Path():
+        return None
+    return CheckpointWriter(get_checkpoint_path(constants.RUN_LOCAL_PATH, runner_id))
@@ -0,0 +1,188 @@
+# Copyright (c) Microsoft Corporation.
+# Licensed under the MIT license.
+
+import json
+import os
+import sys
+import tempfile
+from contextlib import contextmanager
+from dataclasses import dataclass
+from pathlib import Path
+from typing import Dict, Iterator, List, Optional
+
+from dataclasses_json import dataclass_json
+
+from lisa.util import constants
+from lisa.util.logger import Logger
+
+if sys.platform == "win32":
+    import msvcrt
+else:
+    import fcntl
+
+# the average is calculated on recent runs only, so it follows changes of cases.
+_max_sample_count = 10
+
+
+@dataclass_json()
+@dataclass
+class CaseDuration:
+    elapsed: float = 0
+    count: int = 0
+
+    def add(self, elapsed: float) -> None:
+        self.count = min(self.count + 1, _max_sample_count)
+        self.elapsed += (elapsed - self.elapsed) / self.count
+
+
+@contextmanager
+def _lock_file(path: Path) -> Iterator[None]:
+    """
+    An exclusive lock across processes. It's held by the open file, so it's
+    released, even if the process is killed.
+    """
+    with open(path, "a+") as f:
+        if sys.platform == "win32":
+            f.seek(0)
+            # it retries for 10 seconds, and then raises an error.
+            msvcrt.locking(f.fileno(), msvcrt.LK_LOCK, 1)
+            try:
+                yield
+            finally:
+                f.seek(0)
+                msvcrt.locking(f.fileno(), msvcrt.LK_UNLCK, 1)
+        else:
+            fcntl.flock(f.fileno(), fcntl.LOCK_EX)
+            try:
+                yield
+            finally:
+                fcntl.flock(f.fileno(), fcntl.LOCK_UN)
+
+
+class DurationStore:
+    """
+    Durations of test cases, which run on a platform with a vm size. It's saved as
+    a json file, the key is the full name of a test case.
+    """
+
+    def __init__(self, path: Path) -> None:
+        self.path = path
+        self.durations: Dict[str, CaseDuration] = {}
+        # samples of this run. They are merged to the file on saving, since
+        # other runs, like shards, may save it after this run is loaded.
+        self._samples: Dict[str, List[float]] = {}
+
+    def load(self, log: Logger) -> None:
+        if not self.path.exists():
+            return
+        try:
+            with open(self.path, "r") as f:
+                raw_data: Dict[str, Dict[str, float]] = json.load(f)
+            self.durations = {
+                name: CaseDuration.schema().load(value)  # type: ignore
+                for name, value in raw_data.items()
+            }
+        except Exception as identifier:
+            # the history is optional, ignore broken files, and overwrite it later.
+            log.debug(f"ignored broken duration history '{self.path}': {identifier}")
+            self.durations = {}
+
+    def save(self, log: Logger) -> None:
+        if not self._samples:
+            return
+        self.path.parent.mkdir(parents=True, exist_ok=True)
+        # runs in processes may save at the same time, so the file is read again
+        # and merged in the lock. Otherwise, the last writer wins.
+        with _lock_file(self.path.parent / ".lock"):
+            self.load(log)
+            for name, samples in self._samples.items():
+                duration = self.durations.setdefault(name, CaseDuration())
+                for elapsed in samples:
+                    duration.add(elapsed)
+            raw_data: Dict[str, Dict[str, float]] = {
+                name: value.to_dict()  # type: ignore
+                for name, value in self.durations.items()
+            }
+            # write to a temp file and replace, so a broken file won't be left.
+            with tempfile.NamedTemporaryFile(
+                "w", dir=self.path.parent, suffix=".tmp", delete=False
+            ) as f:
+                temp_path = f.name
+                try:
+                    json.dump(raw_data, f, indent=2)
+                except Exception as identifier:
+                    f.close()
+                    os.remove(temp_path)
+                    raise identifier
+            os.replace(temp_path, self.path)
+        self._samples = {}
+
+    def add(self, name: str, elapsed: float) -> None:
+        self._samples.setdefault(name, []).append(elapsed)
+
+
+class DurationHistory:
+    """
+    Historical durations of test cases on a platform. There is a store for each
+    vm size, since a case may run much longer on smaller vm sizes.
+    """
+
+    def __init__(self, platform_type: str, root_path: Path, log: Logger) -> None:
+        self._platform_type = platform_type
+        self._root_path = root_path
+        self._log = log
+        self._stores: Dict[str, DurationStore] = {}
+
+        prefix = self._get_file_name("")
+        if root_path.exists():
+            for path in sorted(root_path.glob(f"{prefix}*.json")):
+                vm_size = path.stem[len(prefix) :]
+                store = DurationStore(path)
+                store.load(log)
+                self._stores[vm_size] = store
+
+    def get_elapsed(self, name: str) -> float:
+        """
+        The vm size is unknown before deployment, so it returns the average on all
+        vm sizes. 0 means no history.
+        """
+        durations: List[CaseDuration] = [
+            store.durations[name]
+            for store in self._stores.values()
+            if name in store.durations
+        ]
+        if not durations:
+            return 0
+        return sum(x.elapsed for x in durations) / len(durations)
+
+    def add(self, name: str, vm_size: str, elapsed: float) -> None:
+        vm_size = constants.NORMALIZE_PATTERN.sub("_", vm_size) if vm_size else ""
+        store = self._stores.get(vm_size)
+        if store is None:
+            store = DurationStore(
+                self._root_path / f"{self._get_file_name(vm_size)}.json"
+            )
+            self._stores[vm_size] = store
+        store.add(name, elapsed)
+
+    def save(self) -> None:
+        for store in self._stores.values():
+            store.save(self._log)
+
+    def _get_file_name(self, vm_size: str) -> str:
+        return f"{self._platform_type}_{vm_size}"
+
+
+def load_duration_history(
+    platform_type: str, path: str, log: Logger
+) -> Optional[DurationHistory]:
+    """
+    path: the folder of the history. If it's empty, the history is not used.
+    """
+    if not path:
+        return None
+    return DurationHistory(
+        platform_type=platform_type,
+        root_path=Path(path),
+        log=log,
+    )
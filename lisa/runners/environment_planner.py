@@ -0,0 +1,132 @@
+# Copyright (c) Microsoft Corporation.
+# Licensed under the MIT license.
+
+from typing import Dict, List, Set
+
+from lisa.environment import Environment, EnvironmentSpace
+from lisa.testsuite import TestResult
+from lisa.util.logger import Logger
+
+
+class EnvironmentPlan:
+    """
+    The environments to deploy, after requirements are merged by planning.
+
+    Environments are generated by exactly matched requirements, so cases with
+    slightly different requirements get different deployments. The min capability
+    of an environment is what will be deployed. If it meets requirements of all
+    cases on another environment, the other one doesn't need to be deployed.
+    """
+
+    def __init__(
+        self, environments: List[Environment], test_results: List[TestResult]
+    ) -> None:
+        self.original: List[Environment] = list(environments)
+        self.selected: List[Environment] = []
+        # name of merged environment, and names of environments to run its cases.
+        self.merged: Dict[str, List[str]] = {}
+
+        self._plan(test_results)
+
+    @property
+    def original_cost(self) -> int:
+        return sum(x.cost for x in self.original)
+
+    @property
+    def selected_cost(self) -> int:
+        return sum(x.cost for x in self.selected)
+
+    def report(self, log: Logger) -> None:
+        log.info(
+            f"environment plan: {len(self.original)} deployments "
+            f"(cost: {self.original_cost}) before planning, "
+            f"{len(self.selected)} deployments "
+            f"(cost: {self.selected_cost}) after planning."
+        )
+        for environment in self.original:
+            if environment.name in self.merged:
+                targets = self.merged[environment.name]
+                log.info(
+                    f"  {environment.name}: merged into {targets}"
+                    if targets
+                    else f"  {environment.name}: no case to run"
+                )
+            else:
+                log.info(
+                    f"  {environment.name}: deploy, cost: {environment.cost}, "
+                    f"capability: {environment.capability}"
+                )
+
+    def _plan(self, test_results: List[TestResult]) -> None:
+        # The cases, which need new environment, run on the environment generated
+        # for them, so those environments are always kept.
+        shared_results = [
+            x
+            for x in test_results
+            if x.is_queued and not x.runtime_data.use_new_environment
+        ]
+        min_capabilities: Dict[str, EnvironmentSpace] = {
+            x.name: _get_min_capability(x) for x in self.original
+        }
+        kept_names: Set[str] = set()
+        for test_result in test_results:
+            if test_result.is_queued and test_result.runtime_data.use_new_environment:
+                for environment in self.original:
+                    if environment.name not in kept_names and _is_covered(
+                        test_result, min_capabilities[environment.name]
+                    ):
+                        kept_names.add(environment.name)
+                        break
+
+        coverages: Dict[str, Set[int]] = {
+            environment.name: {
+                id(x)
+                for x in shared_results
+                if _is_covered(x, min_capabilities[environment.name])
+            }
+            for environment in self.original
+        }
+
+        covered: Set[int] = set()
+        for environment in self.original:
+            if environment.name in kept_names:
+                self.selected.append(environment)
+                covered.update(coverages[environment.name])
+        uncovered: Set[int] = set().union(*coverages.values()) - covered
+
+        # It's a greedy set cover. The environment covers most uncovered cases is
+        # selected first, and the cheaper one is selected, if they cover the same
+        # number of cases. So it gets fewer deployments, and lower cost.
+        candidates = [x for x in self.original if x.name not in kept_names]
+        while uncovered and candidates:
+            best = min(
+                candidates,
+                key=lambda x: (-len(coverages[x.name] & uncovered), x.cost),
+            )
+            candidates.remove(best)
+            self.selected.append(best)
+            uncovered -= coverages[best.name]
+
+        # keep the original order, which is sorted later by runner.
+        selected_names = {x.name for x in self.selected}
+        self.selected = [x for x in self.original if x.name in selected_names]
+        for environment in candidates:
+            self.merged[environment.name] = [
+                x.name
+                for x in self.selected
+                if coverages[environment.name] & coverages[x.name]
+            ]
+
+
+def _get_min_capability(environment: Environment) -> EnvironmentSpace:
+    # The capability of a generated environment may be still a range, if the
+    # platform doesn't replace it by the min capability on preparing.
+    capability = environment.capability
+    min_capability: EnvironmentSpace = capability.generate_min_capability(capability)
+    return min_capability
+
+
+def _is_covered(test_result: TestResult, capability: EnvironmentSpace) -> bool:
+    requirement = test_result.runtime_data.metadata.requirement.environment
+    assert requirement
+    return requirement.check(capability).result
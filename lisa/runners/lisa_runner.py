@@ -2,7 +2,9 @@
 # Licensed under the MIT license.
 
 import copy
+from concurrent.futures import ALL_COMPLETED, Future, ThreadPoolExecutor
 from functools import partial
+from threading import Lock
 from typing import Any, Callable, Dict, List, Optional, cast
 
 from lisa import notifier, schema, search_space
@@ -20,9 +22,22 @@ from lisa.platform_ import (
     load_platform,
 )
 from lisa.runner import BaseRunner
-from lisa.testselector import select_testcases
+from lisa.runners.checkpoint import (
+    CheckpointWriter,
+    RunnerCheckpoint,
+    create_checkpoint_writer,
+    create_environment_checkpoint,
+    create_result_checkpoint,
+    get_checkpoint_path,
+    load_checkpoint,
+)
+from lisa.runners.duration_history import load_duration_history
+from lisa.runners.environment_planner import EnvironmentPlan
+from lisa.runners.result_queue import TestResultQueue, get_sort_key
+from lisa.testselector import select_testcases, shard_testcases
 from lisa.testsuite import TestCaseRequirement, TestResult, TestStatus, TestSuite
 from lisa.util import LisaException, constants, deep_update_dict
+from lisa.util.clock import get_clock
 from lisa.util.parallel import check_cancelled
 from lisa.variable import VariableEntry
 
@@ -38,23 +53,71 @@ class LisaRunner(BaseRunner):
 
         # select test cases
         selected_test_cases = select_testcases(filters=self._runbook.testcase)
+        selected_test_cases = shard_testcases(
+            selected_test_cases,
+            shard_index=self._runbook.shard_index,
+            shard_count=self._runbook.shard_count,
+        )
 
         # create test results
         self.test_results = [
             TestResult(f"{self.id}_{index}", runtime_data=case)
             for index, case in enumerate(selected_test_cases)
         ]
+        # environments are deployed ahead in its own pool, so the deployment time
+        # is hidden behind running cases. It doesn't use workers of test cases.
+        self._lookahead_deployment = self._runbook.lookahead_deployment
+        self._lookahead_pool: Optional[ThreadPoolExecutor] = None
+        self._lookahead_futures: List[Future[List[TestResult]]] = []
+        # a case is bound to the environment deployed ahead for it, so it won't
+        # trigger another deployment, before the environment is used or deleted.
+        self._lookahead_environments: Dict[int, Environment] = {}
+        if self._lookahead_deployment:
+            self._lookahead_pool = ThreadPoolExecutor(
+                max_workers=self._lookahead_deployment,
+                thread_name_prefix="lisa_lookahead",
+            )
         # load predefined environments
         self.platform = load_platform(self._runbook.platform)
         self.platform.initialize()
         platform_message = PlatformMessage(name=self.platform.type_name())
         notifier.notify(platform_message)
 
+        # durations of previous runs are used to run long cases earlier.
+        self._duration_history = load_duration_history(
+            platform_type=self.platform.get_duration_history_type(),
+            path=self._runbook.duration_history_path,
+            log=self._log,
+        )
+        if self._duration_history:
+            for test_result in self.test_results:
+                test_result.expected_elapsed = self._duration_history.get_elapsed(
+                    test_result.runtime_data.metadata.full_name
+                )
+
+        # indexes are updated on status changes of test results, so the scheduling
+        # doesn't need to scan all results.
+        self._result_queue = TestResultQueue(self.test_results)
+
+        # the checkpoint is saved periodically, so an interrupted run can be
+        # resumed without running completed cases and deploying environments.
+        self._checkpoint_writer = create_checkpoint_writer(self.id)
+        self._result_status_version = 0
+        # statuses are changed in worker threads, so checkpoints are saved from
+        # them and from pending timers.
+        self._checkpoint_lock = Lock()
+        if self._checkpoint_writer:
+            for test_result in self.test_results:
+                test_result.add_status_listener(self._on_result_status_changed)
+        self._resume_checkpoint: Optional[RunnerCheckpoint] = None
+        if constants.RESUME_PATH:
+            self._resume_checkpoint = load_checkpoint(
+                get_checkpoint_path(constants.RESUME_PATH, self.id), self._log
+            )
+
     @property
     def is_done(self) -> bool:
-        is_all_results_completed = all(
-            result.is_completed for result in self.test_results
-        )
+        is_all_results_completed = self._result_queue.is_all_completed
         # all environment should not be used and not be deployed.
         is_all_environment_completed = hasattr(self, "environments") and all(
             (not env.is_in_use)
@@ -69,21 +132,168 @@ class LisaRunner(BaseRunner):
             test_results=self.test_results,
         )
         if test_results:
-            # return failed prepared results
+            # return failed prepared and resumed results
             return lambda: test_results
 
+        self._save_checkpoint()
+
+        if self._lookahead_pool:
+            lookahead_results = self._collect_lookahead_results()
+            if lookahead_results:
+                # return failed results of lookahead deployments
+                return lambda: lookahead_results
+            self._start_lookahead_deployments()
+
+        return self._fetch_task()
+
+    def get_waiting_futures(self) -> List[Future[Any]]:
+        # the root runner asks again, once a lookahead deployment is completed.
+        return list(self._lookahead_futures)
+
+    def close(self) -> None:
+        if self._lookahead_pool:
+            # wait deployments completed, so they can be deleted below.
+            get_clock().wait(self._lookahead_futures, return_when=ALL_COMPLETED)
+            self._lookahead_pool.shutdown(wait=True)
+        if hasattr(self, "environments") and self.environments:
+            for environment in self.environments:
+                self._delete_environment_task(environment, [])
+        self._save_checkpoint(force=True)
+        if self._checkpoint_writer:
+            self._checkpoint_writer.cancel_pending()
+        self._save_duration_history()
+        super().close()
+
+    def _save_checkpoint(self, force: bool = False) -> None:
+        if not self._checkpoint_writer:
+            return
+        with self._checkpoint_lock:
+            self._save_checkpoint_locked(self._checkpoint_writer, force=force)
+
+    def _save_checkpoint_locked(
+        self, checkpoint_writer: CheckpointWriter, force: bool
+    ) -> None:
+        environments: List[Environment] = list(getattr(self, "environments", []))
+        # it's called on each scheduling and status change, so it returns before
+        # building the checkpoint, if nothing is changed. If it's saved in the
+        # interval, the change is saved later by the writer.
+        version = (
+            self._result_status_version,
+            tuple((x.name, x.capability_generation) for x in environments),
+        )
+        if not checkpoint_writer.is_due(version, force=force):
+            if checkpoint_writer.is_changed(version):
+                checkpoint_writer.schedule(self._save_checkpoint)
+            return
+        checkpoint = RunnerCheckpoint(
+            runner_id=self.id,
+            run_name=constants.RUN_NAME,
+            results=[create_result_checkpoint(x) for x in self.test_results],
+        )
+        for environment in environments:
+            context: Dict[str, Any] = {}
+            if environment.status in [
+                EnvironmentStatus.Deployed,
+                EnvironmentStatus.Connected,
+            ]:
+                context = self.platform.get_environment_checkpoint(environment)
+            checkpoint.environments.append(
+                create_environment_checkpoint(environment, context)
+            )
+        checkpoint_writer.save(checkpoint, version)
+
+    def _on_result_status_changed(
+        self, test_result: TestResult, previous_status: TestStatus
+    ) -> None:
+        self._result_status_version += 1
+        self._save_checkpoint()
+
+    def _resume_from_checkpoint(self) -> None:
+        checkpoint = self._resume_checkpoint
+        if not checkpoint:
+            return
+
+        # results are matched by id and name, so only the same selection can be
+        # resumed.
+        completed_results = checkpoint.get_completed_results()
+        resumed_count = 0
+        for test_result in self.test_results:
+            result_checkpoint = completed_results.get(test_result.id_)
+            if (
+                not result_checkpoint
+                or not test_result.is_queued
+                or result_checkpoint.name != test_result.runtime_data.metadata.full_name
+            ):
+                continue
+            test_result.elapsed = result_checkpoint.elapsed
+            test_result.set_status(
+                TestStatus[result_checkpoint.status], result_checkpoint.message
+            )
+            resumed_count += 1
+        self._log.info(
+            f"resumed {resumed_count} completed cases from checkpoint, "
+            f"{len(self._result_queue.get_can_run())} cases to run"
+        )
+
+        # environments are generated by the same order, so they are matched by
+        # names.
+        alive_environments = checkpoint.get_alive_environments()
+        for environment in self.environments:
+            environment_checkpoint = alive_environments.get(environment.name)
+            if (
+                not environment_checkpoint
+                or environment_checkpoint.platform != self.platform.type_name()
+                or environment.status != EnvironmentStatus.Prepared
+            ):
+                continue
+            environment.is_new = environment_checkpoint.is_new
+            try:
+                self.platform.restore_environment(
+                    environment, environment_checkpoint.context
+                )
+            except Exception as identifier:
+                matched_results = self._get_runnable_test_results(
+                    test_results=self.test_results, environment=environment
+                )
+                if matched_results:
+                    self._attach_failed_environment_to_result(
+                        environment=environment,
+                        result=matched_results[0],
+                        exception=identifier,
+                    )
+                else:
+                    self._log.info(
+                        f"failed to restore '{environment.name}': {identifier}"
+                    )
+                # clean up resources, which may be restored partially.
+                self.platform.delete_environment(environment)
+
+    def _save_duration_history(self) -> None:
+        if not self._duration_history or not self.platform.is_duration_history_saved():
+            return
+        for test_result in self.test_results:
+            # only passed cases have complete durations.
+            if test_result.status == TestStatus.PASSED and test_result.elapsed:
+                self._duration_history.add(
+                    name=test_result.runtime_data.metadata.full_name,
+                    # the vm size is set by platforms, which support it.
+                    vm_size=test_result.information.get("vmsize", ""),
+                    elapsed=test_result.elapsed,
+                )
+        self._duration_history.save()
+
+    def _fetch_task(self) -> Optional[Callable[[], List[TestResult]]]:
         # sort environments by status
         available_environments = self._sort_environments(self.environments)
-        available_results = [x for x in self.test_results if x.can_run]
-        self._sort_test_results(available_results)
+        has_available_results = self._result_queue.has_can_run
 
         # check deleteable environments
         delete_task = self._delete_unused_environments()
         if delete_task:
             return delete_task
 
-        if available_results and available_environments:
-            can_run_results = self._get_same_priority_results(available_results)
+        if has_available_results and available_environments:
+            can_run_results = self._result_queue.get_same_priority_results()
 
             # it means there are test cases and environment, so it needs to
             # schedule task.
@@ -111,20 +321,16 @@ class LisaRunner(BaseRunner):
                 # no environment in used, and not fit. those results cannot be run.
                 skipped_test_results = self._skip_test_results(can_run_results)
                 return lambda: skipped_test_results
-        elif available_results:
+        elif has_available_results:
             # no available environments, so mark all test results skipped.
-            skipped_test_results = self._skip_test_results(available_results)
+            skipped_test_results = self._skip_test_results(
+                self._result_queue.get_can_run()
+            )
 
             self.status = ActionStatus.SUCCESS
             return lambda: skipped_test_results
         return None
 
-    def close(self) -> None:
-        if hasattr(self, "environments") and self.environments:
-            for environment in self.environments:
-                self._delete_environment_task(environment, [])
-        super().close()
-
     def _associate_environment_test_results(
         self, environment: Environment, test_results: List[TestResult]
     ) -> Optional[Callable[[], List[TestResult]]]:
@@ -191,10 +397,7 @@ class LisaRunner(BaseRunner):
             if environment.is_in_use:
                 continue
 
-            can_run_results = self._get_runnable_test_results(
-                self.test_results, environment=environment
-            )
-            if not can_run_results:
+            if not self._has_runnable_test_result(environment=environment):
                 # no more test need this environment, delete it.
                 self._log.debug(
                     f"generating delete environment task on '{environment.name}'"
@@ -259,12 +462,27 @@ class LisaRunner(BaseRunner):
                     exception=identifier,
                 )
 
+        platform_runbook = cast(schema.Platform, platform.runbook)
+        generated_environments = [
+            x for x in prepared_environments if not x.is_predefined
+        ]
+        if platform_runbook.plan_environment and generated_environments:
+            # merge generated environments, if their cases can run on others.
+            environment_plan = EnvironmentPlan(
+                environments=generated_environments, test_results=self.test_results
+            )
+            environment_plan.report(self._log)
+            prepared_environments = [
+                x for x in prepared_environments if x.is_predefined
+            ] + environment_plan.selected
+
         # sort by environment source and cost cases
         # user defined should be higher priority than test cases' requirement
         prepared_environments.sort(key=lambda x: (not x.is_predefined, x.cost))
 
         self._is_prepared = True
         self.environments = prepared_environments
+        self._resume_from_checkpoint()
         return [x for x in self.test_results if x.is_completed]
 
     def _deploy_environment_task(
@@ -291,13 +509,86 @@ class LisaRunner(BaseRunner):
             )
             self._delete_environment_task(environment=environment, test_results=[])
 
+    def _lookahead_deploy_task(
+        self, environment: Environment, test_results: List[TestResult]
+    ) -> None:
+        self._log.debug(f"start lookahead deployment on '{environment.name}'")
+        self._deploy_environment_task(
+            environment=environment, test_results=test_results
+        )
+        # connect it, if the case needs it. So it's ready to run cases.
+        if (
+            environment.status == EnvironmentStatus.Deployed
+            and test_results[0].runtime_data.metadata.requirement.environment_status
+            == EnvironmentStatus.Connected
+        ):
+            self._initialize_environment_task(
+                environment=environment, test_results=test_results
+            )
+
+    def _start_lookahead_deployments(self) -> None:
+        assert self._lookahead_pool
+        free_slots = self._lookahead_deployment - len(self._lookahead_futures)
+        environments = [
+            x
+            for x in self.environments
+            if x.status == EnvironmentStatus.Prepared and not x.is_in_use
+        ]
+        if free_slots <= 0 or not environments:
+            return
+
+        # deploy environments by the same order of other tasks. Only the first
+        # runnable case is assigned to the deployment, so other cases can run on
+        # connected environments, before the deployment is completed.
+        queued_results = [
+            x
+            for x in self._result_queue.get_by_status(TestStatus.QUEUED)
+            if not self._is_bound_to_lookahead(x)
+        ]
+        for environment in environments:
+            test_result = next(
+                (
+                    x
+                    for x in queued_results
+                    if self._is_runnable_on(x, environment=environment)
+                ),
+                None,
+            )
+            if not test_result:
+                continue
+            queued_results.remove(test_result)
+            self._lookahead_environments[id(test_result)] = environment
+            task = self._generate_task(
+                task_method=self._lookahead_deploy_task,
+                environment=environment,
+                test_results=[test_result],
+            )
+            self._lookahead_futures.append(
+                get_clock().submit(self._lookahead_pool, task)
+            )
+            free_slots -= 1
+            if not free_slots:
+                break
+
+    def _is_bound_to_lookahead(self, test_result: TestResult) -> bool:
+        environment = self._lookahead_environments.get(id(test_result))
+        return environment is not None and environment.is_alive
+
+    def _collect_lookahead_results(self) -> List[TestResult]:
+        results: List[TestResult] = []
+        for future in [x for x in self._lookahead_futures if x.done()]:
+            self._lookahead_futures.remove(future)
+            # exception will throw at this point
+            results.extend(future.result())
+        return results
+
     def _initialize_environment_task(
         self, environment: Environment, test_results: List[TestResult]
     ) -> None:
         self._log.debug(f"start initializing task on '{environment.name}'")
         assert test_results
         try:
-            environment.initialize()
+            self.platform.initialize_environment(environment)
             assert (
                 environment.status == EnvironmentStatus.Connected
             ), f"actual: {environment.status}"
@@ -326,10 +617,15 @@ class LisaRunner(BaseRunner):
         test_suite: TestSuite = suite_metadata.test_class(
             suite_metadata,
         )
-        test_suite.start(
-            environment=environment,
-            case_results=test_results,
-            case_variables=case_variables,
+        self.platform.run_test_results(
+            environment,
+            test_results,
+            partial(
+                test_suite.start,
+                environment=environment,
+                case_results=test_results,
+                case_variables=case_variables,
+            ),
         )
 
     def _delete_environment_task(
@@ -353,25 +649,6 @@ class LisaRunner(BaseRunner):
         else:
             environment.status = EnvironmentStatus.Deleted
 
-    def _get_same_priority_results(
-        self, test_results: List[TestResult]
-    ) -> List[TestResult]:
-        if not test_results:
-            return []
-
-        current_priority = test_results[0].runtime_data.metadata.priority
-        while True:
-            test_results = [
-                x
-                for x in test_results
-                if x.runtime_data.metadata.priority == current_priority
-            ]
-            current_priority += 1
-            if test_results:
-                break
-
-        return test_results
-
     def _generate_task(
         self,
         task_method: Callable[..., None],
@@ -460,36 +737,60 @@ class LisaRunner(BaseRunner):
         results = self._sort_test_results(results)
         return results
 
+    def _has_runnable_test_result(self, environment: Environment) -> bool:
+        # the order doesn't matter, so skip sorting.
+        for result in self._result_queue.get_by_status(
+            TestStatus.QUEUED, is_sorted=False
+        ):
+            if self._is_runnable_on(result, environment=environment):
+                return True
+        return False
+
+    def _is_runnable_on(
+        self,
+        result: TestResult,
+        environment: Environment,
+        environment_status: Optional[EnvironmentStatus] = None,
+    ) -> bool:
+        return (
+            result.is_queued
+            and (
+                environment_status is None
+                or result.runtime_data.metadata.requirement.environment_status
+                == environment_status
+            )
+            and result.check_environment(environment=environment, save_reason=True)
+            and (not result.runtime_data.use_new_environment or environment.is_new)
+        )
+
     def _get_test_results_to_run(
         self, test_results: List[TestResult], environment: Environment
     ) -> List[TestResult]:
-        to_run_results = self._get_runnable_test_results(
-            test_results=test_results,
-            environment_status=environment.status,
-            environment=environment,
+        # the first runnable result decides which results run together. A case
+        # needs new environment runs alone. Otherwise, cases in the same suite run
+        # together, and they are found from the suite group without scanning.
+        first_result = next(
+            (
+                x
+                for x in self._sort_test_results(test_results)
+                if self._is_runnable_on(
+                    x, environment=environment, environment_status=environment.status
+                )
+            ),
+            None,
         )
-        if to_run_results:
-            to_run_test_result = next(
-                (x for x in to_run_results if x.runtime_data.use_new_environment),
-                None,
-            )
-            if to_run_test_result:
-                to_run_test_results: List[TestResult] = [to_run_test_result]
-            else:
-                first_test_result = to_run_results[0]
-                to_run_test_results = []
-                for result in to_run_results:
-                    if (
-                        result.runtime_data.metadata.suite.name
-                        == first_test_result.runtime_data.metadata.suite.name
-                    ):
-                        to_run_test_results.append(result)
-                    else:
-                        # take case with same priority or near cases
-                        break
-            to_run_results = to_run_test_results
+        if not first_result:
+            return []
+        if first_result.runtime_data.use_new_environment:
+            return [first_result]
 
-        return to_run_results
+        return [
+            x
+            for x in self._result_queue.get_suite_group(first_result)
+            if self._is_runnable_on(
+                x, environment=environment, environment_status=environment.status
+            )
+        ]
 
     def _sort_environments(self, environments: List[Environment]) -> List[Environment]:
         results: List[Environment] = []
@@ -508,22 +809,9 @@ class LisaRunner(BaseRunner):
         return results
 
     def _sort_test_results(self, test_results: List[TestResult]) -> List[TestResult]:
-        results = test_results.copy()
-        # sort by priority, use new environment, environment status and suite name.
-        results.sort(
-            key=lambda r: str(r.runtime_data.metadata.suite.name),
-        )
-        # this step make sure Deployed is before Connected
-        results.sort(
-            reverse=True,
-            key=lambda r: str(r.runtime_data.metadata.requirement.environment_status),
-        )
-        results.sort(
-            reverse=True,
-            key=lambda r: str(r.runtime_data.use_new_environment),
-        )
-        results.sort(key=lambda r: r.runtime_data.metadata.priority)
-        return results
+        # sort by priority, use new environment, expected elapsed, environment
+        # status and suite name.
+        return sorted(test_results, key=get_sort_key)
 
     def _skip_test_results(
         self,
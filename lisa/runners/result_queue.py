@@ -0,0 +1,213 @@
+# Copyright (c) Microsoft Corporation.
+# Licensed under the MIT license.
+
+import heapq
+from bisect import bisect_left
+from threading import Lock
+from typing import Dict, Iterable, Iterator, List, Optional, Tuple
+
+from lisa.environment import EnvironmentStatus
+from lisa.testsuite import TestResult, TestStatus
+
+# the environment status is sorted reversely by name, so Deployed is before
+# Connected.
+_environment_status_order: Dict[EnvironmentStatus, int] = {
+    status: index
+    for index, status in enumerate(
+        sorted(EnvironmentStatus, key=lambda x: str(x), reverse=True)
+    )
+}
+
+_can_run_statuses = [TestStatus.QUEUED, TestStatus.ASSIGNED]
+_completed_statuses = [
+    TestStatus.FAILED,
+    TestStatus.PASSED,
+    TestStatus.SKIPPED,
+    TestStatus.ATTEMPTED,
+]
+
+# key of test results, which can run together in one suite run.
+SuiteGroupKey = Tuple[int, bool, EnvironmentStatus, str]
+
+
+def get_sort_key(result: TestResult) -> Tuple[int, bool, float, int, str]:
+    """
+    sort by priority, use new environment, expected elapsed, environment status
+    and suite name. Longer cases run earlier in the same priority, so they won't
+    be the last ones to stretch the total run time.
+    """
+    metadata = result.runtime_data.metadata
+    return (
+        metadata.priority,
+        not result.runtime_data.use_new_environment,
+        -result.expected_elapsed,
+        _environment_status_order[metadata.requirement.environment_status],
+        str(metadata.suite.name),
+    )
+
+
+def get_suite_group_key(result: TestResult) -> SuiteGroupKey:
+    metadata = result.runtime_data.metadata
+    return (
+        metadata.priority,
+        result.runtime_data.use_new_environment,
+        metadata.requirement.environment_status,
+        str(metadata.suite.name),
+    )
+
+
+class TestResultQueue:
+    """
+    Indexes of test results for scheduling. They are updated on status changes of
+    test results, so that the runner doesn't need to scan and sort all results
+    on each scheduling.
+
+    1. buckets of results by status.
+    2. a heap of priorities, which have results can run.
+    3. queued results, which are grouped by suite and other fields, which need to
+       run together.
+
+    Results in indexes are stored as rank, which is the position of the result,
+    when all results are sorted. So the order in each index keeps sorted.
+    """
+
+    def __init__(self, test_results: List[TestResult]) -> None:
+        self._lock = Lock()
+        # results are indexed by object id, as the id_ may not be unique.
+        self._results: List[TestResult] = sorted(test_results, key=get_sort_key)
+        self._ranks: Dict[int, int] = {
+            id(result): rank for rank, result in enumerate(self._results)
+        }
+
+        self._status_buckets: Dict[TestStatus, Dict[int, TestResult]] = {
+            status: {} for status in TestStatus
+        }
+        # ranks of results, which can run, by priority
+        self._can_run_ranks: Dict[int, List[int]] = {}
+        self._priority_heap: List[int] = []
+        # ranks of queued results, by suite group
+        self._suite_groups: Dict[SuiteGroupKey, List[int]] = {}
+
+        for rank, result in enumerate(self._results):
+            self._add(result, rank)
+            result.add_status_listener(self._on_status_changed)
+
+    def __len__(self) -> int:
+        return len(self._results)
+
+    def __iter__(self) -> Iterator[TestResult]:
+        return iter(self._results)
+
+    def get_rank(self, result: TestResult) -> int:
+        return self._ranks[id(result)]
+
+    def sort(self, test_results: Iterable[TestResult]) -> List[TestResult]:
+        return sorted(test_results, key=self.get_rank)
+
+    @property
+    def is_all_completed(self) -> bool:
+        with self._lock:
+            not_completed_count = sum(
+                len(self._status_buckets[status])
+                for status in TestStatus
+                if status not in _completed_statuses
+            )
+        return not_completed_count == 0
+
+    @property
+    def has_can_run(self) -> bool:
+        return self.get_min_priority() is not None
+
+    def get_by_status(
+        self, *statuses: TestStatus, is_sorted: bool = True
+    ) -> List[TestResult]:
+        with self._lock:
+            results: List[TestResult] = []
+            for status in statuses:
+                results.extend(self._status_buckets[status].values())
+        if is_sorted:
+            results = self.sort(results)
+        return results
+
+    def get_can_run(self) -> List[TestResult]:
+        return self.get_by_status(*_can_run_statuses)
+
+    def get_min_priority(self) -> Optional[int]:
+        with self._lock:
+            # priorities are removed lazily, when they have no result.
+            while self._priority_heap and (
+                self._priority_heap[0] not in self._can_run_ranks
+            ):
+                heapq.heappop(self._priority_heap)
+            return self._priority_heap[0] if self._priority_heap else None
+
+    def get_same_priority_results(self) -> List[TestResult]:
+        """
+        return results, which can run and have the highest priority.
+        """
+        priority = self.get_min_priority()
+        if priority is None:
+            return []
+        with self._lock:
+            ranks = list(self._can_run_ranks.get(priority, []))
+        return [self._results[rank] for rank in ranks]
+
+    def get_suite_group(self, result: TestResult) -> List[TestResult]:
+        """
+        return queued results, which can be run with the result in a suite run.
+        """
+        with self._lock:
+            ranks = list(self._suite_groups.get(get_suite_group_key(result), []))
+        return [self._results[rank] for rank in ranks]
+
+    def _on_status_changed(
+        self, result: TestResult, previous_status: TestStatus
+    ) -> None:
+        rank = self._ranks[id(result)]
+        with self._lock:
+            self._remove(result, rank, previous_status)
+            self._add(result, rank)
+
+    def _add(self, result: TestResult, rank: int) -> None:
+        status = result.status
+        self._status_buckets[status][id(result)] = result
+        if status in _can_run_statuses:
+            priority = result.runtime_data.metadata.priority
+            ranks = self._can_run_ranks.get(priority)
+            if ranks is None:
+                ranks = []
+                self._can_run_ranks[priority] = ranks
+                heapq.heappush(self._priority_heap, priority)
+            _insert_rank(ranks, rank)
+        if status == TestStatus.QUEUED:
+            group_key = get_suite_group_key(result)
+            _insert_rank(self._suite_groups.setdefault(group_key, []), rank)
+
+    def _remove(self, result: TestResult, rank: int, status: TestStatus) -> None:
+        self._status_buckets[status].pop(id(result), None)
+        if status in _can_run_statuses:
+            priority = result.runtime_data.metadata.priority
+            ranks = self._can_run_ranks.get(priority)
+            if ranks is not None:
+                _remove_rank(ranks, rank)
+                if not ranks:
+                    del self._can_run_ranks[priority]
+        if status == TestStatus.QUEUED:
+            group_key = get_suite_group_key(result)
+            ranks = self._suite_groups.get(group_key)
+            if ranks is not None:
+                _remove_rank(ranks, rank)
+                if not ranks:
+                    del self._suite_groups[group_key]
+
+
+def _insert_rank(ranks: List[int], rank: int) -> None:
+    index = bisect_left(ranks, rank)
+    if index == len(ranks) or ranks[index] != rank:
+        ranks.insert(index, rank)
+
+
+def _remove_rank(ranks: List[int], rank: int) -> None:
+    index = bisect_left(ranks, rank)
+    if index < len(ranks) and ranks[index] == rank:
+        del ranks[index]
@@ -0,0 +1,71 @@
+# Copyright (c) Microsoft Corporation.
+# Licensed under the MIT license.
+
+from pathlib import Path
+from tempfile import TemporaryDirectory
+from unittest import TestCase
+
+from lisa.runners.duration_history import (
+    CaseDuration,
+    DurationHistory,
+    load_duration_history,
+)
+from lisa.util.logger import get_logger
+
+
+class DurationHistoryTestCase(TestCase):
+    def setUp(self) -> None:
+        self._log = get_logger("duration")
+
+    def test_average_of_recent_runs(self) -> None:
+        duration = CaseDuration()
+        for _ in range(20):
+            duration.add(100)
+        duration.add(200)
+        self.assertEqual(10, duration.count)
+        self.assertAlmostEqual(110, duration.elapsed)
+
+    def test_saved_by_platform_and_vm_size(self) -> None:
+        with TemporaryDirectory() as temp_dir:
+            root_path = Path(temp_dir)
+            history = DurationHistory("azure", root_path, self._log)
+            history.add("suite.case1", "Standard_DS2_v2", 10)
+            history.add("suite.case1", "Standard_DS4_v2", 30)
+            history.add("suite.case2", "", 5)
+            history.save()
+
+            self.assertListEqual(
+                [
+                    "azure_.json",
+                    "azure_Standard_DS2_v2.json",
+                    "azure_Standard_DS4_v2.json",
+                ],
+                sorted(x.name for x in root_path.glob("*.json")),
+            )
+
+            # it's loaded by platform, and averaged on all vm sizes.
+            history = DurationHistory("azure", root_path, self._log)
+            self.assertEqual(20, history.get_elapsed("suite.case1"))
+            self.assertEqual(5, history.get_elapsed("suite.case2"))
+            self.assertEqual(0, history.get_elapsed("suite.case3"))
+            other_history = DurationHistory("ready", root_path, self._log)
+            self.assertEqual(0, other_history.get_elapsed("suite.case1"))
+
+    def test_merged_by_concurrent_runs(self) -> None:
+        with TemporaryDirectory() as temp_dir:
+            root_path = Path(temp_dir)
+            # shards are loaded at the same time, and saved one by one.
+            first = DurationHistory("azure", root_path, self._log)
+            second = DurationHistory("azure", root_path, self._log)
+            first.add("suite.case1", "", 10)
+            second.add("suite.case1", "", 30)
+            second.add("suite.case2", "", 5)
+            first.save()
+            second.save()
+
+            history = DurationHistory("azure", root_path, self._log)
+            self.assertEqual(20, history.get_elapsed("suite.case1"))
+            self.assertEqual(5, history.get_elapsed("suite.case2"))
+
+    def test_not_used_without_path(self) -> None:
+        self.assertIsNone(load_duration_history("azure", "", self._log))
@@ -0,0 +1,68 @@
+# Copyright (c) Microsoft Corporation.
+# Licensed under the MIT license.
+
+from typing import List
+from unittest import TestCase
+
+import lisa
+from lisa.environment import Environment, load_environments
+from lisa.runners.environment_planner import EnvironmentPlan
+from lisa.tests.test_testsuite import cleanup_cases_metadata, generate_cases_result
+from lisa.testsuite import TestResult
+
+
+def generate_environments(test_results: List[TestResult]) -> List[Environment]:
+    environments = load_environments(None)
+    for test_result in test_results:
+        requirement = test_result.runtime_data.metadata.requirement.environment
+        assert requirement
+        environments.from_requirement(requirement)
+    return list(environments.values())
+
+
+class EnvironmentPlanTestCase(TestCase):
+    def setUp(self) -> None:
+        lisa.environment._global_environment_id = 0
+
+    def tearDown(self) -> None:
+        cleanup_cases_metadata()  # Necessary side effects!
+
+    def test_merge_covered_environment(self) -> None:
+        test_results = generate_cases_result()
+        environments = generate_environments(test_results)
+
+        plan = EnvironmentPlan(environments=environments, test_results=test_results)
+
+        # mock_ut2 can run on both 2 nodes and 8 cores environments.
+        self.assertListEqual(
+            ["generated_0", "generated_2"], [x.name for x in plan.selected]
+        )
+        self.assertDictEqual(
+            {"generated_1": ["generated_0", "generated_2"]}, plan.merged
+        )
+
+    def test_select_cheaper_environment(self) -> None:
+        test_results = generate_cases_result()
+        environments = generate_environments(test_results)
+        environments[1].cost = 2
+        environments[2].cost = 1
+
+        plan = EnvironmentPlan(
+            environments=environments[1:], test_results=test_results[1:2]
+        )
+
+        self.assertListEqual(["generated_2"], [x.name for x in plan.selected])
+        self.assertEqual(3, plan.original_cost)
+        self.assertEqual(1, plan.selected_cost)
+
+    def test_keep_environment_for_new_environment_case(self) -> None:
+        test_results = generate_cases_result()
+        environments = generate_environments(test_results)
+        test_results[1].runtime_data.use_new_environment = True
+
+        plan = EnvironmentPlan(environments=environments, test_results=test_results)
+
+        # mock_ut2 needs a new environment, so the first matched one is kept.
+        self.assertListEqual(
+            ["generated_0", "generated_2"], [x.name for x in plan.selected]
+        )
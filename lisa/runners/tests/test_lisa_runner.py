@@ -1,13 +1,21 @@
 # Copyright (c) Microsoft Corporation.
 # Licensed under the MIT license.
 
+from concurrent.futures import FIRST_COMPLETED
+from pathlib import Path
+from tempfile import TemporaryDirectory
+from time import sleep
 from typing import List, Optional, cast
 from unittest import TestCase
+from unittest.mock import patch
 
 import lisa
 from lisa import schema
 from lisa.environment import EnvironmentStatus, load_environments
+from lisa.runners import checkpoint
+from lisa.runners.checkpoint import get_checkpoint_path, load_checkpoint
 from lisa.runners.lisa_runner import LisaRunner
+from lisa.sut_orchestrator import simulation
 from lisa.tests import test_platform, test_testsuite
 from lisa.tests.test_environment import generate_runbook as generate_env_runbook
 from lisa.tests.test_testsuite import (
@@ -17,6 +25,7 @@ from lisa.tests.test_testsuite import (
 )
 from lisa.testsuite import TestResult, TestStatus, simple_requirement
 from lisa.util import LisaException, constants
+from lisa.util.clock import Clock, VirtualClock, get_clock, set_clock
 
 
 def generate_runner(
@@ -24,6 +33,7 @@ def generate_runner(
     case_use_new_env: bool = False,
     times: int = 1,
     platform_schema: Optional[test_platform.MockPlatformSchema] = None,
+    lookahead_deployment: int = 0,
 ) -> LisaRunner:
     platform_runbook = schema.Platform(
         type=constants.PLATFORM_MOCK, admin_password="do-not-use"
@@ -34,6 +44,7 @@ def generate_runner(
         }
     runbook = schema.Runbook(
         platform=[platform_runbook],
+        lookahead_deployment=lookahead_deployment,
     )
     runbook.testcase = [
         schema.TestCase(
@@ -354,6 +365,28 @@ class RunnerTestCase(TestCase):
             test_results=test_results,
         )
 
+    def test_case_new_env_run_with_lookahead_deployment(self) -> None:
+        # same as test_case_new_env_run_only_1_needed_generated, but environments
+        # are deployed ahead, so the order of deployments is not certain.
+        generate_cases_metadata()
+        env_runbook = generate_env_runbook()
+        runner = generate_runner(
+            env_runbook, case_use_new_env=True, times=2, lookahead_deployment=2
+        )
+        test_results = self._run_all_tests(runner)
+        runner.close()
+
+        platform = cast(test_platform.MockPlatform, runner.platform)
+        expected_envs = [f"generated_{index}" for index in range(6)]
+        self.assertListEqual(expected_envs, sorted(platform.test_data.deployed_envs))
+        self.assertListEqual(expected_envs, sorted(platform.test_data.deleted_envs))
+        self.assertListEqual(
+            expected_envs,
+            sorted(x.environment.name for x in test_results if x.environment),
+        )
+        self.assertListEqual([TestStatus.PASSED] * 6, [x.status for x in test_results])
+        self.assertListEqual([], runner._lookahead_futures)
+
     def test_no_needed_env(self) -> None:
         # two 1 node env predefined, but only customized_0 go to deploy
         # no cases assigned to customized_1, as fit cases run on customized_0 already
@@ -498,6 +531,38 @@ class RunnerTestCase(TestCase):
             str(cm.exception),
         )
 
+    def test_plan_environment(self) -> None:
+        # generated_1 is merged, as its case can run on generated_0.
+        generate_cases_metadata()
+        env_runbook = generate_env_runbook()
+        runner = generate_runner(env_runbook)
+        runner._runbook.platform[0].plan_environment = True
+        test_results = self._run_all_tests(runner)
+
+        self.verify_env_results(
+            expected_prepared=[
+                "generated_0",
+                "generated_1",
+                "generated_2",
+            ],
+            expected_deployed_envs=[
+                "generated_0",
+                "generated_2",
+            ],
+            expected_deleted_envs=[
+                "generated_0",
+                "generated_2",
+            ],
+            runner=runner,
+        )
+        self.verify_test_results(
+            expected_test_order=["mock_ut1", "mock_ut2", "mock_ut3"],
+            expected_envs=["generated_0", "generated_0", "generated_2"],
+            expected_status=[TestStatus.PASSED, TestStatus.PASSED, TestStatus.PASSED],
+            expected_message=["", "", ""],
+            test_results=test_results,
+        )
+
     def test_env_deploy_failed(self) -> None:
         # env prepared, but deployment failed, so cases failed
         platform_schema = test_platform.MockPlatformSchema()
@@ -540,6 +605,134 @@ class RunnerTestCase(TestCase):
             test_results=test_results,
         )
 
+    def test_resume_from_checkpoint(self) -> None:
+        # the first run is interrupted, after the first case passed. The resumed
+        # run doesn't run it again, and reuses the deployed environment.
+        generate_cases_metadata()
+        env_runbook = generate_env_runbook()
+        with TemporaryDirectory() as run_path:
+            constants.RUN_LOCAL_PATH = Path(run_path)
+            try:
+                runner = generate_runner(env_runbook)
+                runner.initialize()
+                while not runner.test_results[0].is_completed:
+                    task = runner.fetch_task()
+                    if task:
+                        task()
+                runner._save_checkpoint(force=True)
+
+                lisa.environment._global_environment_id = 0
+                constants.RESUME_PATH = Path(run_path)
+                resumed_runner = generate_runner(env_runbook)
+                test_results = self._run_all_tests(resumed_runner)
+            finally:
+                constants.RUN_LOCAL_PATH = Path()
+                constants.RESUME_PATH = None
+
+        platform = cast(test_platform.MockPlatform, resumed_runner.platform)
+        self.assertListEqual(["generated_0"], platform.test_data.restored_envs)
+        self.assertListEqual(["generated_2"], platform.test_data.deployed_envs)
+        self.verify_test_results(
+            expected_test_order=["mock_ut1", "mock_ut2", "mock_ut3"],
+            # mock_ut1 is resumed, so it has no environment.
+            expected_envs=["", "generated_0", "generated_2"],
+            expected_status=[TestStatus.PASSED, TestStatus.PASSED, TestStatus.PASSED],
+            expected_message=["", "", ""],
+            test_results=test_results,
+        )
+
+    def test_save_checkpoint_on_changes(self) -> None:
+        # the platform is not called for checkpoints, if nothing is changed.
+        generate_cases_metadata()
+        env_runbook = generate_env_runbook()
+        with TemporaryDirectory() as run_path:
+            constants.RUN_LOCAL_PATH = Path(run_path)
+            try:
+                runner = generate_runner(env_runbook)
+                runner.initialize()
+                while not runner.test_results[0].is_completed:
+                    task = runner.fetch_task()
+                    if task:
+                        task()
+                runner._save_checkpoint(force=True)
+                platform = cast(test_platform.MockPlatform, runner.platform)
+                checkpoint_count = platform.test_data.checkpoint_count
+
+                runner._save_checkpoint(force=True)
+                runner.fetch_task()
+                self.assertEqual(checkpoint_count, platform.test_data.checkpoint_count)
+
+                runner.test_results[1].set_status(TestStatus.SKIPPED, "")
+                runner._save_checkpoint(force=True)
+                self.assertLess(checkpoint_count, platform.test_data.checkpoint_count)
+            finally:
+                constants.RUN_LOCAL_PATH = Path()
+                runner.close()
+
+    def test_save_pending_checkpoint(self) -> None:
+        # a change in the interval is saved, once the interval passes, without
+        # waiting for the next scheduling.
+        generate_cases_metadata()
+        env_runbook = generate_env_runbook()
+        with TemporaryDirectory() as run_path:
+            constants.RUN_LOCAL_PATH = Path(run_path)
+            try:
+                with patch.object(checkpoint, "_save_interval", 0.5):
+                    runner = generate_runner(env_runbook)
+                    runner.initialize()
+                    runner._save_checkpoint(force=True)
+                    checkpoint_path = get_checkpoint_path(Path(run_path), runner.id)
+                    saved_time = checkpoint_path.stat().st_mtime_ns
+
+                    runner.test_results[0].set_status(TestStatus.SKIPPED, "")
+                    self.assertEqual(saved_time, checkpoint_path.stat().st_mtime_ns)
+                    sleep(1)
+                    saved = load_checkpoint(checkpoint_path, runner._log)
+                    assert saved
+                    self.assertEqual(TestStatus.SKIPPED.name, saved.results[0].status)
+            finally:
+                constants.RUN_LOCAL_PATH = Path()
+                runner.close()
+
+    def test_simulation(self) -> None:
+        # durations are modeled by the simulation platform, and cases are not run.
+        generate_cases_metadata()
+        env_runbook = generate_env_runbook()
+        runner = generate_runner(env_runbook)
+        runner._runbook.platform = [
+            schema.Platform(
+                type=constants.PLATFORM_SIMULATION,
+                admin_password="do-not-use",
+                extended_schemas={
+                    constants.PLATFORM_SIMULATION: {
+                        "case_time": 10,
+                    }
+                },
+            )
+        ]
+        simulation.statistics.reset()
+        clock = VirtualClock()
+        set_clock(clock)
+        try:
+            test_results = self._run_all_tests(runner)
+            runner.close()
+        finally:
+            set_clock(Clock())
+
+        self.verify_test_results(
+            expected_test_order=["mock_ut1", "mock_ut2", "mock_ut3"],
+            expected_envs=["generated_0", "generated_0", "generated_2"],
+            expected_status=[TestStatus.PASSED, TestStatus.PASSED, TestStatus.PASSED],
+            expected_message=["simulated", "simulated", "simulated"],
+            test_results=test_results,
+        )
+        self.assertEqual(2, simulation.statistics.deployments)
+        # the concurrency is 1, so environments are deployed one by one.
+        self.assertEqual(1, simulation.statistics.peak_environment_count)
+        self.assertEqual(0, simulation.statistics.environment_count)
+        # 2 deployments, initializations and deletions, and 3 cases in sequence.
+        self.assertEqual(2 * (300 + 30 + 60) + 3 * 10, clock.time())
+
     def test_env_skipped_no_case(self) -> None:
         # no case found, as not call generate_case_metadata
         # in this case, not deploy any env
@@ -636,4 +829,9 @@ class RunnerTestCase(TestCase):
                 temp_test_results = task()
                 if temp_test_results:
                     test_results.extend(temp_test_results)
+                continue
+            futures = runner.get_waiting_futures()
+            if futures:
+                # like the root runner, it's asked again, once a future is done.
+                get_clock().wait(futures, return_when=FIRST_COMPLETED)
         return test_results
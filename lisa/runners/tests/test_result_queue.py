@@ -0,0 +1,79 @@
+# Copyright (c) Microsoft Corporation.
+# Licensed under the MIT license.
+
+from unittest import TestCase
+
+from lisa.runners.result_queue import TestResultQueue
+from lisa.tests.test_testsuite import cleanup_cases_metadata, generate_cases_result
+from lisa.testsuite import TestStatus
+
+
+class TestResultQueueTestCase(TestCase):
+    def tearDown(self) -> None:
+        cleanup_cases_metadata()  # Necessary side effects!
+
+    def test_sorted_by_priority(self) -> None:
+        test_results = generate_cases_result()
+        queue = TestResultQueue(list(reversed(test_results)))
+
+        self.assertListEqual(
+            ["mock_ut1", "mock_ut2", "mock_ut3"], [x.name for x in queue]
+        )
+        self.assertEqual(0, queue.get_min_priority())
+        self.assertListEqual(
+            ["mock_ut1"], [x.name for x in queue.get_same_priority_results()]
+        )
+
+    def test_updated_on_status_changed(self) -> None:
+        test_results = generate_cases_result()
+        queue = TestResultQueue(test_results)
+
+        test_results[0].set_status(TestStatus.ASSIGNED, "")
+        # assigned results can run, so the priority is kept.
+        self.assertEqual(0, queue.get_min_priority())
+        self.assertListEqual(
+            ["mock_ut2", "mock_ut3"],
+            [x.name for x in queue.get_by_status(TestStatus.QUEUED)],
+        )
+
+        test_results[0].set_status(TestStatus.PASSED, "")
+        self.assertEqual(1, queue.get_min_priority())
+        self.assertFalse(queue.is_all_completed)
+
+        # returned to queue, the higher priority is back.
+        test_results[0].set_status(TestStatus.QUEUED, "")
+        self.assertEqual(0, queue.get_min_priority())
+
+        for test_result in test_results:
+            test_result.set_status(TestStatus.SKIPPED, "")
+        self.assertIsNone(queue.get_min_priority())
+        self.assertFalse(queue.has_can_run)
+        self.assertTrue(queue.is_all_completed)
+
+    def test_suite_group(self) -> None:
+        test_results = generate_cases_result()
+        for test_result in test_results:
+            test_result.runtime_data.metadata.priority = 1
+        queue = TestResultQueue(test_results)
+
+        self.assertListEqual(
+            ["mock_ut1", "mock_ut2"],
+            [x.name for x in queue.get_suite_group(test_results[1])],
+        )
+        test_results[0].set_status(TestStatus.RUNNING, "")
+        self.assertListEqual(
+            ["mock_ut2"], [x.name for x in queue.get_suite_group(test_results[1])]
+        )
+
+    def test_sorted_by_expected_elapsed(self) -> None:
+        test_results = generate_cases_result()
+        for test_result in test_results:
+            test_result.runtime_data.metadata.priority = 1
+        test_results[2].expected_elapsed = 10
+        test_results[1].expected_elapsed = 20
+        queue = TestResultQueue(test_results)
+
+        # longer cases run earlier in the same priority.
+        self.assertListEqual(
+            ["mock_ut2", "mock_ut3", "mock_ut1"], [x.name for x in queue]
+        )
@@ -628,6 +628,24 @@ class RemoteNode(Node):
     username: str = constants.DEFAULT_USER_NAME
     password: str = ""
     private_key_file: str = ""
+    # max count of concurrent channels on the SSH connection.
+    max_channels: int = field(
+        default=7,
+        metadata=metadata(field_function=fields.Int, validate=validate.Range(min=1)),
+    )
+    # run commands in a long-lived shell on the node.
+    use_session: bool = False
+    # run commands by an agent on the node.
+    use_agent: bool = False
+    # the implementation to run commands and operate files on the node.
+    shell_backend: str = field(
+        default=constants.SHELL_BACKEND_SPUR,
+        metadata=metadata(
+            validate=validate.OneOf(
+                [constants.SHELL_BACKEND_SPUR, constants.SHELL_BACKEND_PARAMIKO]
+            )
+        ),
+    )
 
     def __post_init__(self, *args: Any, **kwargs: Any) -> None:
         add_secret(self.username, PATTERN_HEADTAIL)
@@ -704,6 +722,11 @@ class Platform(TypedSchema, ExtendableSchemaMixin):
     # platform can specify a default environment requirement
     requirement: Optional[Dict[str, Any]] = None
 
+    # merge generated environments before deploying, if cases of an environment
+    # can run on other environments. It reduces deployments, but cases may run on
+    # environments with more capabilities, so it's opt-in.
+    plan_environment: bool = False
+
     def __post_init__(self, *args: Any, **kwargs: Any) -> None:
         add_secret(self.admin_username, PATTERN_HEADTAIL)
         add_secret(self.admin_password)
@@ -860,6 +883,25 @@ class Runbook:
     test_pass: str = ""
     tags: Optional[List[str]] = None
     concurrency: int = 1
+    # number of environments can be deployed ahead, while cases are running.
+    lookahead_deployment: int = field(
+        default=0,
+        metadata=metadata(field_function=fields.Int, validate=validate.Range(min=0)),
+    )
+    # the folder of durations of test cases, so long cases run earlier. The run
+    # and simulate commands set it in the cache folder by default. Empty means
+    # not to use the history.
+    duration_history_path: str = ""
+    # split selected cases to run in multiple processes or hosts. Each one runs
+    # the cases of its shard index.
+    shard_index: int = field(
+        default=0,
+        metadata=metadata(field_function=fields.Int, validate=validate.Range(min=0)),
+    )
+    shard_count: int = field(
+        default=1,
+        metadata=metadata(field_function=fields.Int, validate=validate.Range(min=1)),
+    )
     include: Optional[List[Include]] = field(default=None)
     extension: Optional[List[Union[str, Extension]]] = field(default=None)
     variable: Optional[List[Variable]] = field(default=None)
@@ -874,6 +916,11 @@ class Runbook:
     )
 
     def __post_init__(self, *args: Any, **kwargs: Any) -> None:
+        if self.shard_index >= self.shard_count:
+            raise LisaException(
+                f"shard_index {self.shard_index} must be less than "
+                f"shard_count {self.shard_count}"
+            )
         if not self.platform:
             self.platform = [Platform(type=constants.PLATFORM_READY)]
         if not self.testcase_raw:
@@ -483,6 +483,42 @@ class AzurePlatform(Platform):
                 self._delete_environment(environment, log)
                 raise identifier
 
+    def _get_environment_checkpoint(self, environment: Environment) -> Dict[str, Any]:
+        environment_context = get_environment_context(environment=environment)
+        return {
+            "resource_group_name": environment_context.resource_group_name,
+            "resource_group_is_created": environment_context.resource_group_is_created,
+        }
+
+    def _restore_environment(
+        self, environment: Environment, context: Dict[str, Any], log: Logger
+    ) -> bool:
+        assert self._rm_client
+        assert self._azure_runbook
+
+        resource_group_name: str = context.get("resource_group_name", "")
+        if self._azure_runbook.dry_run or not resource_group_name:
+            return False
+        if not self._rm_client.resource_groups.check_existence(resource_group_name):
+            log.info(f"resource group '{resource_group_name}' doesn't exist")
+            return False
+
+        environment_context = get_environment_context(environment=environment)
+        environment_context.resource_group_name = resource_group_name
+        environment_context.resource_group_is_created = context.get(
+            "resource_group_is_created", False
+        )
+        if not self._load_vms(environment, log):
+            log.info(f"no vm found in resource group '{resource_group_name}'")
+            return False
+
+        # nodes are created like deploying, and the connection information is
+        # loaded from existing vms.
+        log.info(f"reusing resource group: [{resource_group_name}]")
+        self._create_deployment_parameters(resource_group_name, environment, log)
+        self._initialize_nodes(environment, log)
+        return True
+
     def _delete_environment(self, environment: Environment, log: Logger) -> None:
         environment_context = get_environment_context(environment=environment)
         resource_group_name = environment_context.resource_group_name
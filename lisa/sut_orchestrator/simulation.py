@@ -0,0 +1,173 @@
+# Copyright (c) Microsoft Corporation.
+# Licensed under the MIT license.
+
+from dataclasses import dataclass, field
+from threading import Lock, current_thread, main_thread
+from typing import Any, Callable, List, Set, Type
+
+from dataclasses_json import dataclass_json
+from marshmallow import fields, validate
+
+from lisa import schema
+from lisa.environment import Environment, EnvironmentStatus
+from lisa.feature import Feature
+from lisa.platform_ import Platform
+from lisa.schema import metadata
+from lisa.testsuite import TestResult, TestStatus
+from lisa.util import constants
+from lisa.util.clock import get_clock
+from lisa.util.logger import Logger
+
+
+@dataclass_json()
+@dataclass
+class SimulationPlatformSchema:
+    # the simulated platform type. Durations of cases are loaded from the history
+    # of this platform.
+    platform_type: str = ""
+    # modeled durations in seconds. The case time is used, if a case has no
+    # history.
+    deploy_time: float = field(
+        default=300,
+        metadata=metadata(field_function=fields.Float, validate=validate.Range(min=0)),
+    )
+    initialize_time: float = field(
+        default=30,
+        metadata=metadata(field_function=fields.Float, validate=validate.Range(min=0)),
+    )
+    case_time: float = field(
+        default=120,
+        metadata=metadata(field_function=fields.Float, validate=validate.Range(min=0)),
+    )
+    delete_time: float = field(
+        default=60,
+        metadata=metadata(field_function=fields.Float, validate=validate.Range(min=0)),
+    )
+
+
+class SimulationStatistics:
+    """
+    Counters of simulated runs, they are shared by all simulation platforms of
+    runners in a run.
+    """
+
+    def __init__(self) -> None:
+        self._lock = Lock()
+        self.reset()
+
+    def reset(self) -> None:
+        with self._lock:
+            self.deployments: int = 0
+            self.environment_count: int = 0
+            self.peak_environment_count: int = 0
+            # modeled seconds spent in workers, the deletions in the main thread
+            # on closing runners are not counted.
+            self.busy_time: float = 0
+
+    def add_busy_time(self, seconds: float) -> None:
+        if current_thread() is main_thread():
+            return
+        with self._lock:
+            self.busy_time += seconds
+
+    def add_environment(self) -> None:
+        with self._lock:
+            self.deployments += 1
+            self.environment_count += 1
+            self.peak_environment_count = max(
+                self.peak_environment_count, self.environment_count
+            )
+
+    def remove_environment(self) -> None:
+        with self._lock:
+            self.environment_count -= 1
+
+
+statistics = SimulationStatistics()
+
+
+class SimulationPlatform(Platform):
+    """
+    It models durations of deployment, initialization, test cases and deletion,
+    and doesn't touch any node. So the scheduling of a runbook can be simulated to
+    plan concurrency and quota. Durations are spent on the clock, which is a
+    virtual clock in the simulate command.
+    """
+
+    @classmethod
+    def type_name(cls) -> str:
+        return constants.PLATFORM_SIMULATION
+
+    @classmethod
+    def supported_features(cls) -> List[Type[Feature]]:
+        return []
+
+    def get_duration_history_type(self) -> str:
+        return self._simulation_runbook.platform_type or self.type_name()
+
+    def is_duration_history_saved(self) -> bool:
+        # simulated durations are not real.
+        return False
+
+    def _initialize(self, *args: Any, **kwargs: Any) -> None:
+        self._simulation_runbook: SimulationPlatformSchema = (
+            self.runbook.get_extended_runbook(
+                SimulationPlatformSchema, constants.PLATFORM_SIMULATION
+            )
+        )
+        # names of deployed environments. Runners may delete prepared
+        # environments, which are not deployed.
+        self._deployed_environments: Set[str] = set()
+        self._deployed_lock = Lock()
+
+    def _prepare_environment(self, environment: Environment, log: Logger) -> bool:
+        requirements = environment.runbook.nodes_requirement
+        if requirements:
+            min_capabilities: List[schema.NodeSpace] = []
+            for node_space in requirements:
+                min_capabilities.append(node_space.generate_min_capability(node_space))
+            environment.runbook.nodes_requirement = min_capabilities
+        return True
+
+    def _deploy_environment(self, environment: Environment, log: Logger) -> None:
+        with self._deployed_lock:
+            self._deployed_environments.add(environment.name)
+        statistics.add_environment()
+        self._spend(self._simulation_runbook.deploy_time)
+        for node_space in environment.runbook.nodes_requirement or []:
+            environment.nodes.from_requirement(
+                node_requirement=node_space, environment_name=environment.name
+            )
+
+    def _initialize_environment(self, environment: Environment, log: Logger) -> None:
+        # nodes are not connected.
+        self._spend(self._simulation_runbook.initialize_time)
+        environment.status = EnvironmentStatus.Connected
+
+    def _run_test_results(
+        self,
+        environment: Environment,
+        test_results: List[TestResult],
+        run: Callable[[], None],
+        log: Logger,
+    ) -> None:
+        environment.is_new = False
+        for test_result in test_results:
+            test_result.environment = environment
+            test_result.set_status(TestStatus.RUNNING, "")
+            self._spend(
+                test_result.expected_elapsed or self._simulation_runbook.case_time
+            )
+            test_result.set_status(TestStatus.PASSED, "simulated")
+
+    def _delete_environment(self, environment: Environment, log: Logger) -> None:
+        with self._deployed_lock:
+            if environment.name not in self._deployed_environments:
+                return
+            self._deployed_environments.remove(environment.name)
+        self._spend(self._simulation_runbook.delete_time)
+        statistics.remove_environment()
+
+    def _spend(self, seconds: float) -> None:
+        statistics.add_busy_time(seconds)
+        get_clock().sleep(seconds)
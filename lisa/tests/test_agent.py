@@ -0,0 +1,148 @@
+# Copyright (c) Microsoft Corporation.
+# Licensed under the MIT license.
+
+import asyncio
+import shlex
+import subprocess
+import sys
+from pathlib import Path
+from tempfile import TemporaryDirectory
+from typing import IO, Any, List, Optional, cast
+from unittest import skipIf
+from unittest.case import TestCase
+from unittest.mock import Mock
+
+from lisa.util.agent import AGENT_SCRIPT_PATH, AgentClient
+from lisa.util.perf_timer import create_timer
+from lisa.util.process import ExecutableResult, Process
+
+
+class _LocalChannel:
+    """
+    It stands for a SSH channel, and runs the agent locally.
+    """
+
+    def __init__(self) -> None:
+        self._process: Optional["subprocess.Popen[bytes]"] = None
+
+    def exec_command(self, command: str) -> None:
+        self._process = subprocess.Popen(
+            ["sh", "-c", command],
+            stdin=subprocess.PIPE,
+            stdout=subprocess.PIPE,
+            stderr=subprocess.PIPE,
+        )
+
+    def makefile(self, mode: str) -> IO[bytes]:
+        assert self._process
+        return cast(IO[bytes], self._process.stdout)
+
+    def sendall(self, data: bytes) -> None:
+        assert self._process and self._process.stdin
+        self._process.stdin.write(data)
+        self._process.stdin.flush()
+
+    def recv_stderr_ready(self) -> bool:
+        return False
+
+    def close(self) -> None:
+        assert self._process
+        if self._process.stdin and not self._process.stdin.closed:
+            self._process.stdin.close()
+        self._process.wait()
+        for pipe in [self._process.stdout, self._process.stderr]:
+            if pipe:
+                pipe.close()
+
+
+class _LocalTransport:
+    def open_session(self, timeout: float) -> _LocalChannel:
+        return _LocalChannel()
+
+
+@skipIf(sys.platform == "win32", "the agent runs on posix")
+class AgentClientTestCase(TestCase):
+    def setUp(self) -> None:
+        self._client = AgentClient(
+            cast(Any, _LocalTransport()),
+            f"{shlex.quote(sys.executable)} {shlex.quote(str(AGENT_SCRIPT_PATH))}",
+        )
+
+    def tearDown(self) -> None:
+        self._client.close()
+
+    def test_concurrent_commands(self) -> None:
+        slow = self._client.spawn(["sh", "-c", "sleep 0.5; echo slow"])
+        fast = self._client.spawn(
+            ["sh", "-c", "echo $NAME; pwd; echo error >&2; exit 3"],
+            update_env={"NAME": "fast"},
+            cwd="/",
+        )
+
+        result = fast.wait_for_result()
+        self.assertTrue(slow.is_running())
+        self.assertEqual("fast\n/\n", result.output)
+        self.assertEqual("error\n", result.stderr_output)
+        self.assertEqual(3, result.return_code)
+        self.assertEqual("slow\n", slow.wait_for_result().output)
+
+    def test_kill_and_not_found(self) -> None:
+        process = self._client.spawn(["sleep", "100"])
+        self.assertFalse(process.wait(0.2))
+        process.send_signal(9)
+        self.assertTrue(process.wait(5))
+        self.assertEqual(-9, process.wait_for_result().return_code)
+
+        result = self._client.spawn(["lisa_not_exist_command"]).wait_for_result()
+        self.assertEqual(127, result.return_code)
+
+    def test_read_and_stat(self) -> None:
+        with TemporaryDirectory() as temp_dir:
+            path = Path(temp_dir) / "data"
+            path.write_bytes(b"\0binary")
+            self.assertEqual(b"\0binary", self._client.read_bytes(str(path)))
+            self.assertEqual(7, self._client.stat(str(path)).st_size)
+            with self.assertRaises(FileNotFoundError):
+                self._client.stat(str(path.parent / "missing"))
+            with self.assertRaises(IsADirectoryError):
+                self._client.read_bytes(temp_dir)
+
+    def test_pty(self) -> None:
+        result = self._client.spawn(
+            ["sh", "-c", "test -t 1 && echo tty; echo error >&2"], use_pty=True
+        ).wait_for_result()
+        # outputs are in the pty, so stderr is merged into stdout.
+        self.assertEqual("tty\r\nerror\r\n", result.output)
+        self.assertEqual("", result.stderr_output)
+        self.assertEqual(0, result.return_code)
+
+    def test_await_processes(self) -> None:
+        shell = Mock(is_posix=True, is_remote=True)
+        shell.spawn.side_effect = lambda command, stdout, stderr, **_: (
+            self._client.spawn(command, stdout=stdout, stderr=stderr)
+        )
+
+        def _start(command: str) -> Process:
+            process = Process("test", shell)
+            process.start(command, shell=True, no_info_log=True)
+            return process
+
+        async def _gather() -> List[ExecutableResult]:
+            processes = [_start(f"sleep 0.5; echo {x}") for x in range(3)]
+            return list(await asyncio.gather(*processes))
+
+        timer = create_timer()
+        results = asyncio.run(_gather())
+        # they run at the same time.
+        self.assertLess(timer.elapsed(), 1.4)
+        self.assertListEqual(["0", "1", "2"], [x.stdout for x in results])
+
+        process = _start("sleep 100")
+        result = asyncio.run(process.wait_result_async(timeout=0.2))
+        self.assertEqual(-9, result.exit_code)
+
+    def test_closed_agent(self) -> None:
+        process = self._client.spawn(["sleep", "100"])
+        self._client.close()
+        self.assertTrue(process.wait(5))
+        self.assertTrue(self._client.is_closed)
@@ -0,0 +1,137 @@
+# Copyright (c) Microsoft Corporation.
+# Licensed under the MIT license.
+
+import select
+import subprocess
+import sys
+import time
+from typing import Any, List, Optional
+from unittest import skipIf
+from unittest.case import TestCase
+from unittest.mock import Mock, patch
+
+from lisa.util.channel_process import ChannelProcess, generate_run_command
+
+
+class _Channel:
+    def __init__(self, stdout: List[bytes], stderr: List[bytes]) -> None:
+        self.stdout = stdout
+        self.stderr = stderr
+        self.exit_code: Optional[int] = None
+        self.closed = False
+
+    def recv_ready(self) -> bool:
+        return bool(self.stdout)
+
+    def recv(self, size: int) -> bytes:
+        return self.stdout.pop(0)
+
+    def recv_stderr_ready(self) -> bool:
+        return bool(self.stderr)
+
+    def recv_stderr(self, size: int) -> bytes:
+        return self.stderr.pop(0)
+
+    def exit_status_ready(self) -> bool:
+        return self.exit_code is not None
+
+    def recv_exit_status(self) -> int:
+        assert self.exit_code is not None
+        return self.exit_code
+
+    def close(self) -> None:
+        self.closed = True
+
+
+class _LateStderrChannel(_Channel):
+    def __init__(self, stdout: List[bytes], stderr: List[bytes]) -> None:
+        super().__init__(stdout, stderr)
+        self._stderr_checks = 0
+
+    def recv_stderr_ready(self) -> bool:
+        # stderr arrives after it's drained, and before the exit is checked.
+        self._stderr_checks += 1
+        if self._stderr_checks == 2:
+            self.stderr.append(b"late")
+        return super().recv_stderr_ready()
+
+
+class _StreamWriter:
+    keeps_output = True
+
+    def __init__(self) -> None:
+        self.texts: List[str] = []
+
+    def write(self, text: str) -> None:
+        self.texts.append(text)
+
+
+def _select(*args: Any) -> Any:
+    time.sleep(0.01)
+    return [], [], []
+
+
+class ChannelProcessTestCase(TestCase):
+    def test_outputs_and_exit_code(self) -> None:
+        channel = _Channel([b"12", b"34\r\nhel", b"lo\n"], [b"err"])
+        kill = Mock()
+        process = ChannelProcess(
+            channel, kill=kill, stdout=None, stderr=None, encoding="utf-8"
+        )
+
+        self.assertTrue(process.is_running())
+        self.assertEqual("1234", process.pid)
+        process.send_signal(9)
+        kill.assert_called_once_with("1234", 9)
+
+        channel.exit_code = 3
+        self.assertFalse(process.is_running())
+        result = process.wait_for_result()
+        self.assertEqual("hello\n", result.output)
+        self.assertEqual("err", result.stderr_output)
+        self.assertEqual(3, result.return_code)
+
+    def test_late_stderr_and_incomplete_chars(self) -> None:
+        channel = _LateStderrChannel([b"1234\nend\xe4"], [])
+        channel.exit_code = 0
+        process = ChannelProcess(
+            channel, kill=Mock(), stdout=None, stderr=None, encoding="utf-8"
+        )
+
+        with patch.object(select, "select", side_effect=_select):
+            result = process.wait_for_result()
+        self.assertEqual("late", result.stderr_output)
+        # incomplete characters are flushed on exiting.
+        self.assertEqual("end\ufffd", result.output)
+
+    def test_streaming_without_waiting(self) -> None:
+        channel = _Channel([b"12\nhello\n"], [])
+        writer = _StreamWriter()
+        with patch.object(select, "select", side_effect=_select):
+            process = ChannelProcess(
+                channel, kill=Mock(), stdout=writer, stderr=None, encoding="utf-8"
+            )
+            # outputs are read by the reader thread, without waiting.
+            for _ in range(100):
+                if writer.texts:
+                    break
+                time.sleep(0.01)
+            self.assertListEqual(["hello\n"], writer.texts)
+
+            channel.exit_code = 0
+            result = process.wait_for_result()
+        # the stream keeps the output, so it's not kept again.
+        self.assertEqual("", result.output)
+        self.assertEqual(0, result.return_code)
+
+    @skipIf(sys.platform == "win32", "it needs sh")
+    def test_generated_command(self) -> None:
+        command = generate_run_command(
+            ["sh", "-c", "echo $NAME; pwd"], update_env={"NAME": "a b"}, cwd="/"
+        )
+        completed = subprocess.run(
+            ["sh", "-c", command], capture_output=True, check=True
+        )
+        lines = completed.stdout.decode().splitlines()
+        self.assertTrue(lines[0].isdigit())
+        self.assertListEqual(["a b", "/"], lines[1:])
@@ -0,0 +1,52 @@
+# Copyright (c) Microsoft Corporation.
+# Licensed under the MIT license.
+
+from typing import Callable, List
+from unittest.case import TestCase
+
+from lisa.util.clock import Clock, VirtualClock, get_clock, set_clock
+from lisa.util.parallel import TaskManager
+from lisa.util.perf_timer import create_timer
+
+
+def _sleep_task(seconds: float, wakes: List[float]) -> Callable[[], float]:
+    def _task() -> float:
+        get_clock().sleep(seconds)
+        wakes.append(get_clock().time())
+        return seconds
+
+    return _task
+
+
+class VirtualClockTestCase(TestCase):
+    def setUp(self) -> None:
+        self.clock = VirtualClock()
+        set_clock(self.clock)
+
+    def tearDown(self) -> None:
+        set_clock(Clock())
+
+    def test_sleep(self) -> None:
+        self.clock.sleep(100)
+        self.clock.sleep(20)
+        self.assertEqual(120, self.clock.time())
+
+    def test_parallel_tasks(self) -> None:
+        wakes: List[float] = []
+        results: List[float] = []
+        timer = create_timer()
+        task_manager = TaskManager[float](2, results.append)
+        with task_manager:
+            for seconds in [300, 100, 200]:
+                # only 2 workers, so the last task starts, when a task is done.
+                while not task_manager.has_idle_worker():
+                    task_manager.wait_completed()
+                task_manager.submit_task(_sleep_task(seconds, wakes))
+            while task_manager.has_running_task:
+                task_manager.wait_completed()
+
+        self.assertListEqual([100, 300, 300], wakes)
+        self.assertListEqual([100, 200, 300], sorted(results))
+        self.assertEqual(300, self.clock.time())
+        # modeled durations don't take real time.
+        self.assertLess(timer.elapsed(), 1)
@@ -1,19 +1,22 @@
 # Copyright (c) Microsoft Corporation.
 # Licensed under the MIT license.
 
+import copy
 from dataclasses import dataclass, field
+from itertools import count
 from pathlib import Path
 from typing import Any, List, Optional, Type, cast
 from unittest import TestCase
+from unittest.mock import Mock, patch
 
 from dataclasses_json import dataclass_json
 from marshmallow import validate
 
 import lisa
-from lisa import node, schema, search_space
-from lisa.environment import load_environments
+from lisa import environment, node, schema, search_space
+from lisa.environment import EnvironmentStatus, load_environments
 from lisa.testsuite import simple_requirement
-from lisa.util import constants
+from lisa.util import constants, plugin_manager
 
 CUSTOM_LOCAL = "custom_local"
 CUSTOM_REMOTE = "custom_remote"
@@ -267,3 +270,76 @@ class EnvironmentTestCase(TestCase):
                     self.assertEqual(r_n.custom_remote_field, CUSTOM_REMOTE)
                     done += 1
             self.assertEqual(2, done)
+
+    def test_check_requirement_cached_by_generation(self) -> None:
+        runbook = generate_runbook(requirement=True)
+        envs = load_environments(runbook)
+        env = envs.get("customized_0")
+        assert env
+        requirement = simple_requirement(min_count=3).environment
+        assert requirement
+
+        check_result = env.check_requirement(requirement)
+        self.assertFalse(check_result.result)
+        # the returned result is a copy, merging won't change the cache.
+        check_result.add_reason("more reason")
+        self.assertEqual(1, len(env.check_requirement(requirement).reasons))
+        self.assertEqual((1, 1), (env._check_hits, env._check_misses))
+        self.assertIs(env.capability, env.capability)
+
+        # status changes invalidate cached results.
+        env.status = EnvironmentStatus.Deployed
+        self.assertEqual(0, len(env.capability.nodes))
+        env.check_requirement(requirement)
+        self.assertEqual((1, 2), (env._check_hits, env._check_misses))
+
+    def test_requirement_key_cached_on_requirement(self) -> None:
+        requirement = simple_requirement(min_count=1).environment
+        assert requirement
+        key = environment._get_requirement_key(requirement)
+        self.assertIs(key, environment._get_requirement_key(requirement))
+
+        # a copy is changed, so it doesn't use the key of the original one.
+        copied = copy.deepcopy(requirement)
+        copied.topology = "changed"
+        self.assertNotEqual(key, environment._get_requirement_key(copied))
+
+    def test_information_cached_by_generation(self) -> None:
+        runbook = generate_runbook(remote=True)
+        envs = load_environments(runbook)
+        env = envs.get("customized_0")
+        assert env
+        counter = count(1)
+        with patch.object(
+            plugin_manager.hook,
+            "get_environment_information",
+            side_effect=lambda environment: [{"count": str(next(counter))}],
+        ) as information_hook:
+            self.assertEqual({"count": "1"}, env.get_information())
+            env.get_information()
+            self.assertEqual(1, information_hook.call_count)
+
+            # status changes and rebooting nodes invalidate the information.
+            env.status = EnvironmentStatus.Deployed
+            self.assertEqual({"count": "2"}, env.get_information())
+            env.default_node.mark_information_changed()
+            self.assertEqual({"count": "3"}, env.get_information())
+
+    def test_information_refreshed_on_connecting(self) -> None:
+        runbook = generate_runbook(remote=True)
+        envs = load_environments(runbook)
+        env = envs.get("customized_0")
+        assert env
+        counter = count(1)
+        with patch.object(
+            plugin_manager.hook,
+            "get_environment_information",
+            side_effect=lambda environment: [{"count": str(next(counter))}],
+        ), patch.object(node.OperatingSystem, "create", return_value=Mock()):
+            # the information is collected before nodes are connected.
+            self.assertEqual({"count": "1"}, env.get_information())
+            remote_node = cast(node.RemoteNode, env.default_node)
+            remote_node.set_connection_info(address="localhost", password="test")
+            remote_node._shell = Mock()
+            remote_node.initialize()
+            self.assertEqual({"count": "2"}, env.get_information())
@@ -0,0 +1,79 @@
+# Copyright (c) Microsoft Corporation.
+# Licensed under the MIT license.
+
+import time
+from concurrent.futures import ThreadPoolExecutor
+from threading import Lock
+from typing import Any, Dict, List
+from unittest.case import TestCase
+from unittest.mock import Mock
+
+from lisa.executable import Tools
+from lisa.util import InitializableMixin
+from lisa.util.logger import get_logger
+from lisa.util.perf_timer import create_timer
+
+
+class _Slow(InitializableMixin):
+    def __init__(self) -> None:
+        super().__init__()
+        self.count = 0
+
+    def _initialize(self, *args: Any, **kwargs: Any) -> None:
+        time.sleep(0.2)
+        self.count += 1
+        # call again in the initializing thread.
+        self.initialize()
+
+
+class _FakeTool:
+    """
+    It has the methods, which are used by Tools to install a tool.
+    """
+
+    installs: Dict[str, int] = {}
+    lock = Lock()
+
+    def __init__(self, name: str) -> None:
+        self.name = name
+        self.exists = False
+        self.can_install = True
+
+    def initialize(self) -> None:
+        ...
+
+    def install(self) -> bool:
+        time.sleep(0.3)
+        with self.lock:
+            self.installs[self.name] = self.installs.get(self.name, 0) + 1
+        return True
+
+
+def _fake_tool_type(name: str) -> Any:
+    return type(name, (), {"create": staticmethod(lambda node: _FakeTool(name))})
+
+
+class InitializableTestCase(TestCase):
+    def test_initialize_once(self) -> None:
+        item = _Slow()
+        with ThreadPoolExecutor(4) as pool:
+            list(pool.map(lambda _: item.initialize(), range(4)))
+        self.assertEqual(1, item.count)
+
+    def test_install_tools_once(self) -> None:
+        _FakeTool.installs = {}
+        tools = Tools(Mock(log=get_logger("test")))
+        tool_types: List[Any] = [_fake_tool_type("first"), _fake_tool_type("second")]
+
+        def _get(index: int) -> Any:
+            return tools[tool_types[index % 2]]
+
+        timer = create_timer()
+        with ThreadPoolExecutor(6) as pool:
+            results = list(pool.map(_get, range(6)))
+
+        self.assertDictEqual({"first": 1, "second": 1}, _FakeTool.installs)
+        self.assertEqual(1, len({id(x) for x in results[::2]}))
+        self.assertEqual(1, len({id(x) for x in results[1::2]}))
+        # different tools are installed in parallel.
+        self.assertLess(timer.elapsed(), 0.55)
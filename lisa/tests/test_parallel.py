@@ -0,0 +1,93 @@
+# Copyright (c) Microsoft Corporation.
+# Licensed under the MIT license.
+
+from concurrent.futures import Future
+from threading import Event
+from typing import List
+from unittest.case import TestCase
+
+from lisa.util.parallel import ParallelException, TaskManager, run_in_parallel
+
+
+class TaskManagerTestCase(TestCase):
+    def setUp(self) -> None:
+        self._results: List[int] = []
+
+    def test_no_running_task(self) -> None:
+        task_manager = TaskManager[int](2, self._results.append)
+        self.assertListEqual([], task_manager.wait_completed())
+        self.assertFalse(task_manager.has_running_task)
+
+    def test_wait_completed_returns_owner(self) -> None:
+        task_manager = TaskManager[int](2, self._results.append)
+        blocker = Event()
+        task_manager.submit_task(lambda: blocker.wait() and 1, owner="slow")
+        task_manager.submit_task(lambda: 2, owner="fast")
+        self.assertFalse(task_manager.has_idle_worker())
+
+        # only the completed task is returned, the blocked one keeps running.
+        self.assertListEqual(["fast"], task_manager.wait_completed())
+        self.assertListEqual([2], self._results)
+        self.assertTrue(task_manager.has_idle_worker())
+        self.assertTrue(task_manager.has_running_task)
+
+        blocker.set()
+        self.assertListEqual(["slow"], task_manager.wait_completed())
+        self.assertListEqual([2, 1], self._results)
+        self.assertFalse(task_manager.has_running_task)
+        self.assertEqual(1, task_manager.scheduler_passes)
+
+    def test_watched_future_wakes_owner(self) -> None:
+        task_manager = TaskManager[int](1, self._results.append)
+        future: Future[int] = Future()
+        task_manager.watch_future(future, owner="deployment")
+        task_manager.watch_future(future, owner="deployment")
+        # it doesn't use a worker, but the manager waits for it.
+        self.assertTrue(task_manager.has_idle_worker())
+        self.assertTrue(task_manager.has_running_task)
+
+        future.set_result(1)
+        self.assertListEqual(["deployment"], task_manager.wait_completed())
+        # the result is handled by the owner.
+        self.assertListEqual([], self._results)
+        self.assertFalse(task_manager.has_running_task)
+
+    def test_exception_raised_on_wait(self) -> None:
+        def _raise() -> int:
+            raise ValueError("task failed")
+
+        task_manager = TaskManager[int](1, self._results.append)
+        task_manager.submit_task(_raise)
+        with self.assertRaises(ValueError):
+            task_manager.wait_completed()
+        self.assertFalse(task_manager.has_running_task)
+
+
+class RunInParallelTestCase(TestCase):
+    def test_results_in_order(self) -> None:
+        blocker = Event()
+
+        def _unblock() -> int:
+            blocker.set()
+            return 3
+
+        # the first task waits the last one, so they must run in parallel.
+        results = run_in_parallel([lambda: blocker.wait(10) and 1, lambda: 2, _unblock])
+        self.assertListEqual([1, 2, 3], results)
+
+    def test_exceptions_aggregated(self) -> None:
+        def _raise() -> int:
+            raise ValueError("task failed")
+
+        with self.assertRaises(ParallelException) as context:
+            run_in_parallel([lambda: 1, _raise], names=["first", "second"])
+        self.assertListEqual([1, None], context.exception.results)
+        self.assertListEqual([1], list(context.exception.exceptions))
+        self.assertIn("second: ValueError: task failed", str(context.exception))
+
+    def test_nested_calls(self) -> None:
+        # nested calls run in the worker, so they don't wait for the pool.
+        results = run_in_parallel(
+            [lambda: run_in_parallel([lambda: 1, lambda: 2])] * 20
+        )
+        self.assertListEqual([[1, 2]] * 20, results)
@@ -2,7 +2,7 @@
 # Licensed under the MIT license.
 
 from dataclasses import dataclass, field
-from typing import Any, List, Optional, Type, Union
+from typing import Any, Dict, List, Optional, Type, Union
 from unittest.case import TestCase
 
 from dataclasses_json import dataclass_json
@@ -27,6 +27,8 @@ class MockPlatformTestData:
     prepared_envs: List[str] = field(default_factory=list)
     deployed_envs: List[str] = field(default_factory=list)
     deleted_envs: List[str] = field(default_factory=list)
+    restored_envs: List[str] = field(default_factory=list)
+    checkpoint_count: int = 0
 
 
 @dataclass_json()
@@ -106,6 +108,24 @@ class MockPlatform(Platform):
                 f"deployment should be failed"
             )
 
+    def _get_environment_checkpoint(self, environment: Environment) -> Dict[str, Any]:
+        self.test_data.checkpoint_count += 1
+        return {"deployed_name": environment.name}
+
+    def _restore_environment(
+        self, environment: Environment, context: Dict[str, Any], log: Logger
+    ) -> bool:
+        if context.get("deployed_name") != environment.name:
+            return False
+        for node_space in environment.runbook.nodes_requirement or []:
+            environment.nodes.from_requirement(
+                node_requirement=node_space, environment_name=environment.name
+            )
+        for node in environment.nodes.list():
+            node._is_initialized = True
+        self.test_data.restored_envs.append(environment.name)
+        return True
+
     def _delete_environment(self, environment: Environment, log: Logger) -> None:
         self.test_data.deleted_envs.append(environment.name)
         self.delete_called = True
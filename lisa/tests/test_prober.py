@@ -0,0 +1,50 @@
+# Copyright (c) Microsoft Corporation.
+# Licensed under the MIT license.
+
+import socket
+from concurrent.futures import ThreadPoolExecutor
+from time import sleep
+from unittest.case import TestCase
+
+from lisa.util.perf_timer import create_timer
+from lisa.util.prober import TcpPortProber
+
+
+def _get_free_port() -> int:
+    with socket.socket(socket.AF_INET, socket.SOCK_STREAM) as tcp_socket:
+        tcp_socket.bind(("127.0.0.1", 0))
+        port: int = tcp_socket.getsockname()[1]
+    return port
+
+
+class TcpPortProberTestCase(TestCase):
+    def test_timeout_on_closed_port(self) -> None:
+        prober = TcpPortProber()
+        is_ready, error_code = prober.wait("127.0.0.1", _get_free_port(), timeout=0.5)
+        self.assertFalse(is_ready)
+        self.assertNotEqual(0, error_code)
+
+    def test_ready_once_opened(self) -> None:
+        prober = TcpPortProber()
+        closed_port = _get_free_port()
+        with socket.socket(
+            socket.AF_INET, socket.SOCK_STREAM
+        ) as opened, ThreadPoolExecutor(2) as pool:
+            opened.bind(("127.0.0.1", 0))
+            opened.listen()
+            opened_port = opened.getsockname()[1]
+
+            # both ports are probed together.
+            closed_future = pool.submit(prober.wait, "127.0.0.1", closed_port, 10)
+            opened_future = pool.submit(prober.wait, "127.0.0.1", opened_port, 10)
+            self.assertEqual((True, 0), opened_future.result())
+
+            sleep(0.5)
+            self.assertFalse(closed_future.done())
+            with socket.socket(socket.AF_INET, socket.SOCK_STREAM) as later:
+                later.bind(("127.0.0.1", closed_port))
+                later.listen()
+                timer = create_timer()
+                self.assertEqual((True, 0), closed_future.result())
+                # the max delay of retrying is 1 second.
+                self.assertLess(timer.elapsed(), 2)
@@ -0,0 +1,118 @@
+# Copyright (c) Microsoft Corporation.
+# Licensed under the MIT license.
+
+import logging
+import subprocess
+import sys
+from pathlib import Path
+from tempfile import TemporaryDirectory
+from typing import List
+from unittest import skipIf
+from unittest.case import TestCase
+
+from lisa.util.local_process import LocalStreamProcess
+from lisa.util.logger import LogWriter, get_logger
+from lisa.util.process import CommandBatch, ExecutableResult, OutputStream, Process
+from lisa.util.shell import LocalShell
+
+
+class CommandBatchTestCase(TestCase):
+    @skipIf(sys.platform == "win32", "it needs sh")
+    def test_results_of_commands(self) -> None:
+        batch = CommandBatch(
+            ["echo hello", "echo error >&2; exit 3", "printf 'no line end'", "true"]
+        )
+        completed = subprocess.run(
+            ["sh", "-c", batch.script], capture_output=True, check=True
+        )
+        results = batch.parse(ExecutableResult(completed.stdout.decode(), "", 0, "", 0))
+
+        self.assertListEqual(
+            [
+                ("hello", "", 0),
+                ("", "error", 3),
+                ("no line end", "", 0),
+                ("", "", 0),
+            ],
+            [(x.stdout, x.stderr, x.exit_code) for x in results],
+        )
+        self.assertEqual("echo hello", results[0].cmd)
+        self.assertGreaterEqual(results[0].elapsed, 0)
+
+    def test_killed_batch(self) -> None:
+        batch = CommandBatch(["echo hello", "sleep 100", "echo never"])
+        sentinel = batch._get_sentinel
+        stdout = (
+            f"{sentinel(0)}_begin:1.5\r\nhello\r\n{sentinel(0)}_end:0:2.0\r\n"
+            f"{sentinel(0)}_stderr\r\n{sentinel(1)}_begin:2.0\r\npartial"
+        )
+        results = batch.parse(ExecutableResult(stdout, "", None, "", 0))
+
+        self.assertListEqual(
+            [("hello", 0, 0.5), ("partial", None, 0), ("", None, 0)],
+            [(x.stdout, x.exit_code, x.elapsed) for x in results],
+        )
+
+
+class OutputStreamTestCase(TestCase):
+    def test_lines_and_spill(self) -> None:
+        lines: List[str] = []
+        log = get_logger("test")
+        with TemporaryDirectory() as temp_dir:
+            stream = OutputStream(
+                log_writer=LogWriter(log, logging.DEBUG),
+                line_handler=lines.append,
+                spill_path=Path(temp_dir),
+                log=log,
+                memory_limit=10,
+            )
+            for chunk in ["li", "ne1\r\nline2\n", "line3\nlast"]:
+                stream.write(chunk)
+            self.assertListEqual(["line1", "line2", "line3"], lines)
+            stream.close()
+
+            self.assertListEqual(["line1", "line2", "line3", "last"], lines)
+            # the beginning part is kept in memory.
+            self.assertEqual("line1\r\nlin", stream.output)
+            assert stream.spilled_path
+            self.assertEqual(
+                "line1\r\nline2\nline3\nlast",
+                stream.spilled_path.read_bytes().decode("utf-8"),
+            )
+
+    def test_no_spill_path(self) -> None:
+        log = get_logger("test")
+        stream = OutputStream(
+            log_writer=LogWriter(log, logging.DEBUG),
+            line_handler=None,
+            spill_path=None,
+            log=log,
+            memory_limit=1,
+        )
+        stream.write("all in memory")
+        stream.close()
+        self.assertEqual("all in memory", stream.output)
+        self.assertIsNone(stream.spilled_path)
+
+
+class LocalStreamTestCase(TestCase):
+    @skipIf(sys.platform == "win32", "it needs sh")
+    def test_streaming_local_command(self) -> None:
+        shell = LocalShell()
+        shell.initialize()
+        lines: List[str] = []
+        process = Process("test", shell)
+        process.start(
+            "echo line1; echo error >&2; echo line2",
+            shell=True,
+            no_info_log=True,
+            line_handler=lines.append,
+        )
+        # spur keeps a copy of the output, so it's not used in streaming.
+        self.assertIsInstance(process._process, LocalStreamProcess)
+        result = process.wait_result()
+
+        self.assertListEqual(["line1", "line2"], lines)
+        self.assertEqual("line1\nline2", result.stdout)
+        self.assertEqual("error", result.stderr)
+        self.assertEqual(0, result.exit_code)
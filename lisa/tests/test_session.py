@@ -0,0 +1,77 @@
+# Copyright (c) Microsoft Corporation.
+# Licensed under the MIT license.
+
+import subprocess
+import sys
+from typing import List
+from unittest import skipIf
+from unittest.case import TestCase
+from unittest.mock import Mock
+
+from lisa.util.session import SessionProcess, ShellSession
+
+
+class _Writer:
+    def __init__(self) -> None:
+        self.texts: List[str] = []
+
+    def write(self, text: str) -> None:
+        self.texts.append(text)
+
+
+class SessionProcessTestCase(TestCase):
+    def setUp(self) -> None:
+        self._session = Mock()
+        self._stdout = _Writer()
+        self._process = SessionProcess(
+            self._session, stdout=self._stdout, stderr=None, encoding="utf-8"
+        )
+
+    def test_output_between_sentinels(self) -> None:
+        begin = self._process.begin_sentinel
+        end = self._process.end_sentinel
+        stdout = f"left by others\n{begin}:123\nhello\nworld{end}:2\n".encode()
+        # sentinels and characters are split into chunks.
+        for index in range(0, len(stdout), 7):
+            self._process.feed_stdout(stdout[index : index + 7])
+        self.assertTrue(self._process.is_running())
+        self._process.feed_stderr(f"{begin}:\nerror\n{end}:\n".encode())
+
+        self.assertFalse(self._process.is_running())
+        self._session.on_exited.assert_called_once_with(self._process)
+        result = self._process.wait_for_result()
+        self.assertEqual("hello\nworld", result.output)
+        self.assertEqual("hello\nworld", "".join(self._stdout.texts))
+        self.assertEqual("error\n", result.stderr_output)
+        self.assertEqual(2, result.return_code)
+
+        self._process.send_signal(9)
+        self._session.kill.assert_not_called()
+
+    def test_exit_callback(self) -> None:
+        called: List[str] = []
+        self._process.add_exit_callback(lambda: called.append("before"))
+        self.assertListEqual([], called)
+        self._process.close()
+        self._process.add_exit_callback(lambda: called.append("after"))
+        self.assertListEqual(["before", "after"], called)
+
+    @skipIf(sys.platform == "win32", "it needs sh")
+    def test_generated_script(self) -> None:
+        session = ShellSession.__new__(ShellSession)
+        script = session._generate_script(
+            self._process,
+            ["sh", "-c", 'echo "$VALUE" && pwd && echo error >&2 && exit 3'],
+            update_env={"VALUE": "a b"},
+            cwd="/",
+        )
+        completed = subprocess.run(
+            ["sh"], input=script.encode(), capture_output=True, check=True
+        )
+        self._process.feed_stdout(completed.stdout)
+        self._process.feed_stderr(completed.stderr)
+
+        result = self._process.wait_for_result()
+        self.assertEqual("a b\n/\n", result.output)
+        self.assertEqual("error\n", result.stderr_output)
+        self.assertEqual(3, result.return_code)
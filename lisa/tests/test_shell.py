@@ -0,0 +1,270 @@
+# Copyright (c) Microsoft Corporation.
+# Licensed under the MIT license.
+
+import asyncio
+import socket
+from threading import Thread
+from time import sleep
+from typing import Any, List, Union
+from unittest.case import TestCase
+from unittest.mock import Mock, call, patch
+
+from lisa.util import LisaException
+from lisa.util.channel_process import ChannelProcess
+from lisa.util.perf_timer import create_timer
+from lisa.util.process import Process
+from lisa.util.session import SessionResult
+from lisa.util.shell import (
+    ChannelBusyError,
+    ChannelPool,
+    ConnectionInfo,
+    SshShell,
+    _detect_is_posix,
+    _probe_shell,
+    _SpawnTransport,
+)
+
+
+class ChannelPoolTestCase(TestCase):
+    def test_waiters_acquire_in_order(self) -> None:
+        pool = ChannelPool(1)
+        pool.acquire()
+        acquired: List[int] = []
+
+        def _acquire(index: int) -> None:
+            pool.acquire()
+            acquired.append(index)
+
+        threads: List[Thread] = []
+        for index in range(3):
+            thread = Thread(target=_acquire, args=(index,))
+            thread.start()
+            threads.append(thread)
+            # make sure waiters are queued in the order.
+            while len(pool._waiters) <= index:
+                sleep(0.01)
+
+        self.assertListEqual([], acquired)
+        for index in range(3):
+            pool.release()
+            threads[index].join(timeout=10)
+            self.assertListEqual(list(range(index + 1)), acquired)
+
+        # no waiter, the released channel is free again.
+        pool.release()
+        self.assertEqual(1, pool._available)
+
+    def test_timeout_and_close(self) -> None:
+        pool = ChannelPool(1)
+        pool.acquire()
+        with self.assertRaises(LisaException):
+            pool.acquire(timeout=0.1)
+        self.assertEqual(0, len(pool._waiters))
+
+        errors: List[Exception] = []
+
+        def _acquire() -> None:
+            try:
+                pool.acquire()
+            except LisaException as identifier:
+                errors.append(identifier)
+
+        thread = Thread(target=_acquire)
+        thread.start()
+        while not pool._waiters:
+            sleep(0.01)
+        # waiters don't wait for channels of a closed transport.
+        pool.close()
+        thread.join(timeout=10)
+        self.assertEqual(1, len(errors))
+
+    def test_acquire_in_loop(self) -> None:
+        pool = ChannelPool(1)
+        pool.acquire()
+
+        async def _acquire_in_loop() -> None:
+            with self.assertRaises(ChannelBusyError):
+                await pool.acquire_async(timeout=0.1)
+            self.assertEqual(0, len(pool._waiters))
+
+            # the channel is released by another thread, and handed over.
+            waiting = asyncio.ensure_future(pool.acquire_async())
+            await asyncio.sleep(0.01)
+            Thread(target=pool.release).start()
+            await asyncio.wait_for(waiting, 10)
+
+            # a cancelled waiter doesn't take the channel.
+            waiting = asyncio.ensure_future(pool.acquire_async())
+            await asyncio.sleep(0.01)
+            waiting.cancel()
+            with self.assertRaises(asyncio.CancelledError):
+                await waiting
+            pool.release()
+            pool.acquire(timeout=0)
+
+        asyncio.run(_acquire_in_loop())
+
+
+class SshShellChannelTestCase(TestCase):
+    def setUp(self) -> None:
+        self._shell = SshShell(
+            ConnectionInfo(address="localhost", password="test", max_channels=1)
+        )
+        # it doesn't connect, and commands are started by the mock.
+        self._shell._is_initialized = True
+        self._shell.is_posix = True
+        self._processes: List[Any] = []
+
+        def _spawn(**kwargs: Any) -> Any:
+            process = Mock(spec=ChannelProcess)
+            process._channel = Mock(closed=False)
+            process.wait.return_value = True
+            process.is_running.return_value = False
+            process.wait_for_result.return_value = SessionResult("", "", 0)
+            self._processes.append(process)
+            return process
+
+        self._shell._spawn_in_channel = _spawn  # type: ignore
+
+    def test_release_once(self) -> None:
+        first = self._shell.spawn(["true"])
+        self._shell.release_channel(first)
+        self._shell.release_channel(first)
+        self._shell.spawn(["true"])
+        # the channel is released once, so there is no free channel.
+        with self.assertRaises(LisaException):
+            self._shell._channel_pool.acquire(timeout=0.1)
+
+    def test_release_exited_and_closed(self) -> None:
+        self._shell.spawn(["true"])
+        # it's not waited, but the channel is closed after it exits.
+        self._processes[0]._channel.closed = True
+        second = self._shell.spawn(["true"])
+
+        # a new connection has all channels, and the old process doesn't change it.
+        self._shell.close()
+        self._shell._is_initialized = True
+        self._shell.release_channel(second)
+        self._shell.spawn(["true"])
+        with self.assertRaises(LisaException):
+            self._shell._channel_pool.acquire(timeout=0.1)
+
+    def test_release_on_error(self) -> None:
+        process = Process("test", self._shell)
+        process.start("true", no_info_log=True)
+        self._processes[0].wait_for_result.side_effect = OSError("closed")
+        with self.assertRaises(OSError):
+            process.wait_result()
+        self._shell.spawn(["true"])
+
+    def test_waiting_channel_in_event_loop(self) -> None:
+        async def _start_in_loop() -> None:
+            first = Process("first", self._shell)
+            first.start("true", no_info_log=True)
+            second = Process("second", self._shell)
+            second.start("true", no_info_log=True)
+            # there is no free channel, so it's spawned, when it's awaited.
+            waiting = asyncio.ensure_future(second.wait_result_async())
+            await asyncio.sleep(0.1)
+            self.assertEqual(1, len(self._processes))
+
+            await first.wait_result_async()
+            result = await asyncio.wait_for(waiting, 10)
+            self.assertEqual(0, result.exit_code)
+            self.assertEqual(2, len(self._processes))
+
+        asyncio.run(_start_in_loop())
+
+    def test_streaming_in_channel(self) -> None:
+        # spur keeps a copy of the output, so streaming commands don't use it.
+        shell = SshShell(ConnectionInfo(address="localhost", password="test"))
+        shell.is_posix = True
+        shell._inner_shell = Mock()
+        shell._spawn_transport = _SpawnTransport(Mock())
+        stream = Mock(keeps_output=True)
+        with patch.object(shell, "_spawn_channel_process") as spawn_channel_process:
+            shell._spawn_in_channel(command=["true"], stdout=stream)
+            shell._spawn_in_channel(command=["true"], stdout=Mock(keeps_output=False))
+        spawn_channel_process.assert_called_once_with(command=["true"], stdout=stream)
+        shell._inner_shell.spawn.assert_called_once()
+
+    def test_no_waiting_in_event_loop(self) -> None:
+        async def _spawn_in_loop() -> None:
+            self._shell.spawn(["true"])
+            # waiting blocks the loop, which releases the channel.
+            timer = create_timer()
+            with self.assertRaises(LisaException):
+                self._shell.spawn(["true"])
+            self.assertLess(timer.elapsed(), 1)
+
+        asyncio.run(_spawn_in_loop())
+
+
+class DetectShellTestCase(TestCase):
+    def _create_transport(self, *outputs: Union[bytes, Exception]) -> Mock:
+        transport = Mock()
+        # it fails on reading more than outputs.
+        transport.open_session.return_value.recv.side_effect = list(outputs)
+        return transport
+
+    def test_detect_posix(self) -> None:
+        # the error message is in stderr, and stdout ends at once.
+        transport = self._create_transport(b"")
+        self.assertTrue(_detect_is_posix(transport))
+        transport.open_session.return_value.close.assert_called_once()
+
+    def test_detect_windows(self) -> None:
+        # the stream may not end on Windows, so it stops once detected.
+        transport = self._create_transport(b"\r\nMicrosoft Win", b"dows [Version]")
+        self.assertFalse(_detect_is_posix(transport))
+
+    def test_probe_shell(self) -> None:
+        # the pid and the exit code of "which" are printed.
+        transport = self._create_transport(b"1234\n", b"0\n", b"")
+        self.assertTrue(_probe_shell(transport, "true", timeout=1))
+
+    def test_probe_stuck_shell(self) -> None:
+        transport = self._create_transport(b"welcome\n", socket.timeout())
+        self.assertFalse(_probe_shell(transport, "true", timeout=1))
+        transport.open_session.return_value.settimeout.assert_called_once_with(1)
+        transport.open_session.return_value.close.assert_called_once()
+
+
+class SpawnTransportTestCase(TestCase):
+    def _create(self) -> Any:
+        transport = Mock()
+        channel = transport.open_session.return_value
+        return _SpawnTransport(transport), channel
+
+    def test_spawn_in_time(self) -> None:
+        spawn_transport, channel = self._create()
+        result = spawn_transport.spawn(
+            lambda: spawn_transport.open_session(), 0.1, ["test"]
+        )
+        # reads time out in the spawn only.
+        self.assertListEqual([call(0.1), call(None)], channel.settimeout.call_args_list)
+        channel.close.assert_not_called()
+        # a read, which is started in the spawn, is retried after that.
+        channel.recv.side_effect = [socket.timeout(), b"data"]
+        self.assertEqual(b"data", result.recv(1024))
+        # other attributes are from the transport.
+        spawn_transport.open_sftp_client()
+        # channels out of spawns are not changed.
+        self.assertEqual(channel, spawn_transport.open_session())
+
+    def test_hung_spawn(self) -> None:
+        # the connection is probed already, and the shell hangs on a spawn.
+        shell = SshShell(ConnectionInfo(address="localhost", password="test"))
+        spawn_transport, channel = self._create()
+        shell._spawn_transport = spawn_transport
+        shell._inner_shell = Mock()
+        # spur reads the pid, and the channel doesn't return it in the timeout.
+        channel.recv.side_effect = socket.timeout()
+
+        def _spawn(**kwargs: Any) -> None:
+            spawn_transport.open_session().makefile("rb").readline()
+
+        shell._inner_shell.spawn.side_effect = _spawn
+        with self.assertRaises(LisaException):
+            shell._spawn_in_channel(command=["test"])
+        channel.close.assert_called_once()
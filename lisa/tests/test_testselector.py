@@ -4,6 +4,7 @@
 from unittest import TestCase
 
 from lisa.tests.test_testsuite import cleanup_cases_metadata, select_and_check
+from lisa.testselector import shard_testcases
 from lisa.util import LisaException, constants
 
 
@@ -150,3 +151,25 @@ class SelectorTestCase(TestCase):
         selected = select_and_check(self, runbook, ["ut1", "ut2"])
 
         self.assertListEqual([2, 3], [case.retry for case in selected])
+
+    def test_shard_keep_same_requirement_together(self) -> None:
+        runbook = [
+            {constants.TESTCASE_CRITERIA: {"priority": [0, 1, 2]}},
+            {
+                constants.TESTCASE_CRITERIA: {"name": "mock_ut2"},
+                "times": 2,
+                constants.TESTCASE_SELECT_ACTION: "none",
+            },
+        ]
+        selected = select_and_check(self, runbook, ["ut1", "ut2", "ut2", "ut3"])
+
+        # ut2 is heaviest, so it's in the first shard, and others are in the
+        # second one.
+        first_shard = shard_testcases(selected, shard_index=0, shard_count=2)
+        second_shard = shard_testcases(selected, shard_index=1, shard_count=2)
+        self.assertListEqual(["ut2", "ut2"], [x.description for x in first_shard])
+        self.assertListEqual(["ut1", "ut3"], [x.description for x in second_shard])
+
+        self.assertListEqual(
+            selected, shard_testcases(selected, shard_index=0, shard_count=1)
+        )
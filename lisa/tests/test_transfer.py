@@ -0,0 +1,145 @@
+# Copyright (c) Microsoft Corporation.
+# Licensed under the MIT license.
+
+import os
+import subprocess
+import sys
+from pathlib import Path, PurePosixPath
+from tempfile import TemporaryDirectory
+from typing import IO, Any, Optional, cast
+from unittest import skipIf
+from unittest.case import TestCase
+
+from lisa.executable import CustomScriptBuilder
+from lisa.util import LisaException
+from lisa.util.transfer import download_by_tar, upload_by_tar
+
+
+class _LocalChannel:
+    """
+    It stands for a SSH channel, and runs commands in local sh.
+    """
+
+    def __init__(self) -> None:
+        self._process: Optional["subprocess.Popen[bytes]"] = None
+
+    def exec_command(self, command: str) -> None:
+        self._process = subprocess.Popen(
+            ["sh", "-c", command],
+            stdin=subprocess.PIPE,
+            stdout=subprocess.PIPE,
+            stderr=subprocess.PIPE,
+        )
+
+    def sendall(self, data: bytes) -> None:
+        assert self._process and self._process.stdin
+        self._process.stdin.write(data)
+
+    def shutdown_write(self) -> None:
+        assert self._process and self._process.stdin
+        self._process.stdin.close()
+
+    def makefile(self, mode: str) -> IO[bytes]:
+        assert self._process
+        return cast(IO[bytes], self._process.stdout)
+
+    def makefile_stderr(self, mode: str) -> IO[bytes]:
+        assert self._process
+        return cast(IO[bytes], self._process.stderr)
+
+    def exit_status_ready(self) -> bool:
+        assert self._process
+        return self._process.poll() is not None
+
+    def recv_exit_status(self) -> int:
+        assert self._process
+        return self._process.wait()
+
+    def close(self) -> None:
+        assert self._process
+        if self._process.poll() is None:
+            self._process.kill()
+        self._process.wait()
+        for pipe in [self._process.stdin, self._process.stdout, self._process.stderr]:
+            if pipe:
+                pipe.close()
+
+
+class _LocalTransport:
+    def open_session(self) -> _LocalChannel:
+        return _LocalChannel()
+
+
+@skipIf(sys.platform == "win32", "it needs sh and tar")
+class DownloadByTarTestCase(TestCase):
+    def test_download_folder(self) -> None:
+        with TemporaryDirectory() as node_dir, TemporaryDirectory() as local_dir:
+            source = Path(node_dir) / "logs"
+            (source / "sub").mkdir(parents=True)
+            (source / "a.log").write_text("hello")
+            (source / "sub" / "b.log").write_bytes(b"\0" * 100000)
+
+            target = Path(local_dir) / "node0" / "copied"
+            size = download_by_tar(
+                cast(Any, _LocalTransport()), PurePosixPath(source), target
+            )
+
+            self.assertGreater(size, 0)
+            self.assertEqual("hello", (target / "a.log").read_text())
+            self.assertEqual(100000, (target / "sub" / "b.log").stat().st_size)
+
+    def test_download_file(self) -> None:
+        with TemporaryDirectory() as node_dir, TemporaryDirectory() as local_dir:
+            source = Path(node_dir) / "a.log"
+            source.write_text("hello")
+
+            target = Path(local_dir) / "b.log"
+            download_by_tar(cast(Any, _LocalTransport()), PurePosixPath(source), target)
+
+            self.assertEqual("hello", target.read_text())
+
+    def test_missing_path(self) -> None:
+        with TemporaryDirectory() as node_dir, TemporaryDirectory() as local_dir:
+            with self.assertRaises(LisaException):
+                download_by_tar(
+                    cast(Any, _LocalTransport()),
+                    PurePosixPath(node_dir) / "missing",
+                    Path(local_dir) / "missing",
+                )
+
+
+@skipIf(sys.platform == "win32", "it needs sh and tar")
+class UploadByTarTestCase(TestCase):
+    def test_upload_script_bundle(self) -> None:
+        with TemporaryDirectory() as local_dir, TemporaryDirectory() as node_dir:
+            (Path(local_dir) / "sub").mkdir()
+            (Path(local_dir) / "run.sh").write_text("echo hello")
+            (Path(local_dir) / "sub" / "lib.sh").write_text("echo lib")
+            builder = CustomScriptBuilder(Path(local_dir), ["run.sh", "sub/lib.sh"])
+            content_hash, archive = builder.get_bundle()
+            # it's packed once.
+            self.assertIs(archive, builder.get_bundle()[1])
+
+            target = Path(node_dir) / "tool" / builder.name
+            upload_by_tar(cast(Any, _LocalTransport()), archive, PurePosixPath(target))
+
+            self.assertEqual("echo lib", (target / "sub" / "lib.sh").read_text())
+            self.assertTrue(os.access(target / "run.sh", os.X_OK))
+            self.assertTrue((target / f".{content_hash}").exists())
+
+            # the hash changes with contents.
+            (Path(local_dir) / "run.sh").write_text("echo changed")
+            changed_builder = CustomScriptBuilder(
+                Path(local_dir), ["run.sh", "sub/lib.sh"]
+            )
+            self.assertEqual(builder.name, changed_builder.name)
+            self.assertNotEqual(content_hash, changed_builder.get_bundle()[0])
+
+    def test_upload_failed(self) -> None:
+        with TemporaryDirectory() as node_dir:
+            with self.assertRaises(LisaException):
+                upload_by_tar(
+                    cast(Any, _LocalTransport()),
+                    b"not an archive",
+                    PurePosixPath(node_dir) / "target",
+                )
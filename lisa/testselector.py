@@ -1,6 +1,7 @@
 # Copyright (c) Microsoft Corporation.
 # Licensed under the MIT license.
 
+import json
 import re
 from functools import partial
 from typing import Callable, Dict, List, Mapping, Optional, Pattern, Set, Union, cast
@@ -61,6 +62,75 @@ def select_testcases(
     return results
 
 
+def shard_testcases(
+    cases: List[TestCaseRuntimeData], shard_index: int, shard_count: int
+) -> List[TestCaseRuntimeData]:
+    """
+    Split selected cases into shards, and return cases of the shard index. It
+    runs in each process separately, so the result must be deterministic.
+
+    Cases with the same environment requirement are kept in the same shard, so
+    they can share environments. Groups are assigned from heavy to light, to the
+    lightest shard. The weight of a group is the count of cases and deployments,
+    the cases which need new environment have a deployment for each.
+    """
+    if shard_count <= 1:
+        return cases
+    log = _get_logger()
+
+    groups: Dict[str, List[TestCaseRuntimeData]] = {}
+    case_keys: List[str] = []
+    for case in cases:
+        key = _get_shard_group_key(case)
+        groups.setdefault(key, []).append(case)
+        case_keys.append(key)
+
+    def _get_weight(group: List[TestCaseRuntimeData]) -> int:
+        deployment_count = sum(1 for x in group if x.use_new_environment)
+        if deployment_count < len(group):
+            deployment_count += 1
+        return len(group) + deployment_count
+
+    # the first case name is used to sort, it's unique and stable across processes.
+    sorted_keys = sorted(
+        groups,
+        key=lambda x: (
+            -_get_weight(groups[x]),
+            min(case.metadata.full_name for case in groups[x]),
+        ),
+    )
+    shard_weights = [0] * shard_count
+    shard_keys: List[Set[str]] = [set() for _ in range(shard_count)]
+    for key in sorted_keys:
+        index = shard_weights.index(min(shard_weights))
+        shard_weights[index] += _get_weight(groups[key])
+        shard_keys[index].add(key)
+
+    # keep the selected order
+    results = [
+        case for case, key in zip(cases, case_keys) if key in shard_keys[shard_index]
+    ]
+    log.info(
+        f"shard {shard_index}/{shard_count}: selected {len(results)} of "
+        f"{len(cases)} cases, shard weights: {shard_weights}"
+    )
+    return results
+
+
+def _get_shard_group_key(case: TestCaseRuntimeData) -> str:
+    requirement = case.metadata.requirement
+    environment_data = (
+        requirement.environment.to_dict()  # type: ignore
+        if requirement.environment
+        else None
+    )
+    return json.dumps(
+        [environment_data, requirement.environment_status.name],
+        sort_keys=True,
+        default=str,
+    )
+
+
 def _match_string(
     case: Union[TestCaseRuntimeData, TestCaseMetadata],
     pattern: Pattern[str],
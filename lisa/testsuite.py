@@ -84,6 +84,8 @@ class TestResult:
     runtime_data: TestCaseRuntimeData
     status: TestStatus = TestStatus.QUEUED
     elapsed: float = 0
+    # the elapsed of previous runs, it's used to run long cases earlier.
+    expected_elapsed: float = 0
     message: str = ""
     environment: Optional[Environment] = None
     check_results: Optional[search_space.ResultReason] = None
@@ -107,6 +109,7 @@ class TestResult:
         ]
 
     def __post_init__(self, *args: Any, **kwargs: Any) -> None:
+        self._status_listeners: List[Callable[[TestResult, TestStatus], None]] = []
         self._send_result_message()
         self._timer: Timer
 
@@ -142,6 +145,15 @@ class TestResult:
                 log.error("case failed", exc_info=exception)
                 self.set_status(TestStatus.FAILED, f"{phase}failed: {exception}")
 
+    def add_status_listener(
+        self, listener: Callable[[TestResult, TestStatus], None]
+    ) -> None:
+        """
+        The listener is called with this result and the previous status, after the
+        status is changed. It's used to maintain indexes of test results.
+        """
+        self._status_listeners.append(listener)
+
     def set_status(
         self, new_status: TestStatus, message: Union[str, List[str]]
     ) -> None:
@@ -152,9 +164,12 @@ class TestResult:
                 message.insert(0, self.message)
             self.message = "\n".join(message)
         if self.status != new_status:
+            previous_status = self.status
             self.status = new_status
             if new_status == TestStatus.RUNNING:
                 self._timer = create_timer()
+            for listener in self._status_listeners:
+                listener(self, previous_status)
             self._send_result_message()
 
     def check_environment(
@@ -162,7 +177,8 @@ class TestResult:
     ) -> bool:
         requirement = self.runtime_data.metadata.requirement
         assert requirement.environment
-        check_result = requirement.environment.check(environment.capability)
+        # the result is cached by environment, it's a copy to merge more reasons.
+        check_result = environment.check_requirement(requirement.environment)
         if (
             check_result.result
             and requirement.os_type
@@ -117,18 +117,17 @@ class Lsvmbus(Tool):
         self._vmbus_devices: List[VmBusDevice] = []
 
     def _check_exists(self) -> bool:
-        _exists = super()._check_exists()
-
-        if not _exists:
-            previous_command = self._command
-            self._command = "$HOME/.local/bin/lsvmbus"
-            _exists = super()._check_exists()
-            if not _exists:
-                self._command = previous_command
-            self._command = "/usr/sbin/lsvmbus"
-            _exists = super()._check_exists()
-            if not _exists:
-                self._command = previous_command
+        # check all possible paths in one round trip, and use the first found.
+        commands = [self._command, "$HOME/.local/bin/lsvmbus", "/usr/sbin/lsvmbus"]
+        results = self.node.execute_batch(
+            [f"command -v {command}" for command in commands]
+        )
+        _exists = False
+        for command, result in zip(commands, results):
+            if result.exit_code == 0:
+                self._command = command
+                _exists = True
+                break
 
         if _exists and isinstance(self.node.os, Ubuntu):
             # fix for issue happen on Canonical UbuntuServer 16.04-LTS 16.04.201703020
@@ -1,13 +1,11 @@
 # Copyright (c) Microsoft Corporation.
 # Licensed under the MIT license.
 
-from datetime import datetime, timedelta
+from datetime import timedelta
 from pathlib import Path
 from time import sleep
 from typing import Any
 
-from func_timeout import FunctionTimedOut, func_set_timeout  # type: ignore
-
 from lisa.executable import Tool
 from lisa.features import SerialConsole
 from lisa.util import LisaException
@@ -18,16 +16,12 @@ from .uptime import Uptime
 from .who import Who
 
 
-# this method is easy to stuck on reboot, so use timeout to recycle it faster.
-@func_set_timeout(30)  # type: ignore
-def _who_last(who: Who) -> datetime:
-    return who.last_boot()
-
-
 class Reboot(Tool):
     def _initialize(self, *args: Any, **kwargs: Any) -> None:
         # timeout to wait
         self.time_out: int = 300
+        # timeout of checking the boot time, when the node is rebooting.
+        self._check_time_out: int = 10
         self._command = "/sbin/reboot"
 
     @property
@@ -100,6 +94,8 @@ class Reboot(Tool):
         except Exception as identifier:
             # it doesn't matter to exceptions here. The system may reboot fast
             self._log.debug(f"ignorable exception on rebooting: {identifier}")
+        # the kernel may be changed after rebooting.
+        self.node.mark_information_changed()
 
         connected: bool = False
         while (
@@ -107,12 +103,11 @@ class Reboot(Tool):
         ):
             try:
                 self.node.close()
-                current_boot_time = _who_last(who)
+                # connecting and starting are limited by timeouts of the
+                # connection, and the command has its own timeout. So it
+                # doesn't stuck on a rebooting node.
+                current_boot_time = who.last_boot(timeout=self._check_time_out)
                 connected = True
-            except FunctionTimedOut as identifier:
-                # The FunctionTimedOut must be caught separated, or the process
-                # will exit.
-                self._log.debug(f"ignorable timeout exception: {identifier}")
             except Exception as identifier:
                 # error is ignorable, as ssh may be closed suddenly.
                 self._log.debug(f"ignorable ssh exception: {identifier}")
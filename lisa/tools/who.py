@@ -21,10 +21,10 @@ class Who(Tool):
     def can_install(self) -> bool:
         return False
 
-    def last_boot(self, no_error_log: bool = True) -> datetime:
+    def last_boot(self, no_error_log: bool = True, timeout: int = 10) -> datetime:
         # always force run, because it's used to detect if the system is rebooted.
         command_result = self.run(
-            "-b", force_run=True, no_error_log=no_error_log, timeout=10
+            "-b", force_run=True, no_error_log=no_error_log, timeout=timeout
         )
         if command_result.exit_code != 0:
             raise LisaException(
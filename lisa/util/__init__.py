@@ -4,6 +4,7 @@
 import re
 from datetime import datetime
 from pathlib import Path
+from threading import Lock, RLock
 from typing import Any, Dict, Iterable, List, Optional, Pattern, Type, TypeVar
 
 import pluggy
@@ -93,11 +94,16 @@ class InitializableMixin:
     __init__ shouldn't do time costing work as most design recommendation. But
     something may be done let an object works. _initialize uses to call for one time
     initialization. If an object is initialized, it do nothing.
+
+    It's thread safe. If it's initializing in a thread, other threads wait until
+    it's done. The lock is reentrant, so the initializing thread can call
+    initialize again, and it returns directly.
     """
 
     def __init__(self) -> None:
         super().__init__()
         self._is_initialized: bool = False
+        self._initialize_lock = RLock()
 
     def _initialize(self, *args: Any, **kwargs: Any) -> None:
         """
@@ -109,13 +115,39 @@ class InitializableMixin:
         """
         This is for caller, do not override it.
         """
-        if not self._is_initialized:
-            try:
-                self._is_initialized = True
-                self._initialize(*args, **kwargs)
-            except Exception as identifier:
-                self._is_initialized = False
-                raise identifier
+        # the flag is set before _initialize is done, so it's checked in the lock
+        # only. Otherwise, other threads may use an object, which is initializing.
+        with self._initialize_lock:
+            if not self._is_initialized:
+                try:
+                    self._is_initialized = True
+                    self._initialize(*args, **kwargs)
+                except Exception as identifier:
+                    self._is_initialized = False
+                    raise identifier
+
+
+class KeyLocks:
+    """
+    It provides a lock for each key. Work on the same key runs one by one, and work
+    on different keys runs in parallel. For example, a tool is installed once, when
+    it's requested by multiple threads, and other tools aren't blocked.
+    """
+
+    def __init__(self) -> None:
+        self._lock = Lock()
+        self._locks: Dict[str, Any] = {}
+
+    def get(self, key: str) -> Any:
+        """
+        The lock is reentrant, so the same thread can acquire it again.
+        """
+        with self._lock:
+            lock = self._locks.get(key)
+            if lock is None:
+                lock = RLock()
+                self._locks[key] = lock
+            return lock
 
 
 class BaseClassMixin:
@@ -0,0 +1,246 @@
+# Copyright (c) Microsoft Corporation.
+# Licensed under the MIT license.
+
+import base64
+import codecs
+import json
+import os
+from pathlib import Path
+from threading import Event, Lock, Thread
+from typing import Any, Callable, Dict, List, Mapping, Optional, Sequence
+
+import paramiko
+
+from lisa.util import LisaException
+
+from .session import SESSION_CLOSED_EXIT_CODE, ExitEvent, SessionResult, is_output_kept
+
+# the script runs on nodes, it's copied by the shell.
+AGENT_SCRIPT_PATH = Path(__file__).parent / "agent_server.py"
+
+
+class AgentProcess:
+    """
+    A command, which runs by the agent on the node. It has the same methods as
+    spur processes, which are used by Process.
+    """
+
+    def __init__(
+        self,
+        client: "AgentClient",
+        id_: int,
+        stdout: Any,
+        stderr: Any,
+        encoding: str,
+    ) -> None:
+        self._client = client
+        self.id_ = id_
+        self._stdout_writer = stdout
+        self._stderr_writer = stderr
+        decoder_type = codecs.getincrementaldecoder(encoding)
+        self._stdout_decoder = decoder_type(errors="replace")
+        self._stderr_decoder = decoder_type(errors="replace")
+        self._stdout: List[str] = []
+        self._stderr: List[str] = []
+        self._exited = ExitEvent()
+        self._return_code = SESSION_CLOSED_EXIT_CODE
+
+    def is_running(self) -> bool:
+        return not self._exited.is_set()
+
+    def wait(self, timeout: Optional[float] = None) -> bool:
+        return self._exited.wait(timeout)
+
+    def add_exit_callback(self, callback: Callable[[], None]) -> None:
+        self._exited.add_callback(callback)
+
+    def wait_for_result(self) -> SessionResult:
+        self._exited.wait()
+        return SessionResult(
+            output="".join(self._stdout),
+            stderr_output="".join(self._stderr),
+            return_code=self._return_code,
+        )
+
+    def send_signal(self, signal_number: int) -> None:
+        if self.is_running():
+            self._client.kill(self.id_, signal_number)
+
+    def on_message(self, message: Dict[str, Any]) -> None:
+        if "out" in message:
+            text = self._stdout_decoder.decode(base64.b64decode(message["out"]))
+            self._write(text, self._stdout, self._stdout_writer)
+        elif "err" in message:
+            text = self._stderr_decoder.decode(base64.b64decode(message["err"]))
+            self._write(text, self._stderr, self._stderr_writer)
+        elif "exit" in message:
+            self._return_code = message["exit"]
+            self.close()
+
+    def close(self) -> None:
+        self._exited.set()
+
+    def _write(self, text: str, outputs: List[str], writer: Any) -> None:
+        if text:
+            if not is_output_kept(writer):
+                outputs.append(text)
+            if writer:
+                writer.write(text)
+
+
+class _Call:
+    def __init__(self) -> None:
+        self.completed = Event()
+        self.response: Dict[str, Any] = {}
+
+    def on_message(self, message: Dict[str, Any]) -> None:
+        self.response = message
+        self.completed.set()
+
+    def close(self) -> None:
+        self.response = {"error": "agent is closed"}
+        self.completed.set()
+
+
+class AgentClient:
+    """
+    It starts the agent on a node in one channel, and sends requests to it. Many
+    commands can run at the same time in the channel, and commands don't pay for
+    opening channels. The protocol is documented in agent_server.py.
+    """
+
+    def __init__(
+        self, transport: paramiko.Transport, command: str, timeout: float = 10
+    ) -> None:
+        self._channel = transport.open_session(timeout=timeout)
+        self._channel.exec_command(command)
+        self._stdout = self._channel.makefile("rb")
+        self._send_lock = Lock()
+        self._pending_lock = Lock()
+        self._pending: Dict[int, Any] = {}
+        self._next_id = 1
+        self._is_closed = False
+
+        ready = _Call()
+        self._pending[0] = ready
+        self._reader = Thread(target=self._read, daemon=True)
+        self._reader.start()
+        if not ready.completed.wait(timeout) or "ready" not in ready.response:
+            self.close()
+            stderr = ""
+            if self._channel.recv_stderr_ready():
+                stderr = self._channel.recv_stderr(65536).decode("utf-8", "replace")
+            raise LisaException(f"failed to start agent: {stderr.strip()}")
+
+    @property
+    def is_closed(self) -> bool:
+        return self._is_closed
+
+    def spawn(
+        self,
+        command: Sequence[str],
+        update_env: Optional[Mapping[str, str]] = None,
+        cwd: Optional[str] = None,
+        stdout: Any = None,
+        stderr: Any = None,
+        encoding: str = "utf-8",
+        use_pty: bool = False,
+    ) -> AgentProcess:
+        """
+        use_pty: outputs are written to a pty, so commands see a terminal, and
+            stderr is merged into stdout like SSH channels with pty.
+        """
+        with self._pending_lock:
+            id_ = self._allocate_id()
+            process = AgentProcess(
+                self, id_, stdout=stdout, stderr=stderr, encoding=encoding
+            )
+            self._pending[id_] = process
+        self._send(
+            {
+                "id": id_,
+                "op": "exec",
+                "cmd": list(command),
+                "env": dict(update_env) if update_env else {},
+                "cwd": cwd,
+                "pty": use_pty,
+            }
+        )
+        return process
+
+    def kill(self, id_: int, signal_number: int) -> None:
+        self._send({"id": 0, "op": "kill", "target": id_, "signal": signal_number})
+
+    def read_bytes(self, path: str) -> bytes:
+        response = self._call({"op": "read", "path": path})
+        return base64.b64decode(response["data"])
+
+    def stat(self, path: str) -> os.stat_result:
+        response = self._call({"op": "stat", "path": path})
+        return os.stat_result(response["stat"])
+
+    def close(self) -> None:
+        self._is_closed = True
+        # the agent kills running commands, when its stdin is closed.
+        self._channel.close()
+
+    def _allocate_id(self) -> int:
+        id_ = self._next_id
+        self._next_id += 1
+        return id_
+
+    def _call(self, request: Dict[str, Any], timeout: float = 60) -> Dict[str, Any]:
+        call = _Call()
+        with self._pending_lock:
+            request["id"] = self._allocate_id()
+            self._pending[request["id"]] = call
+        self._send(request)
+        if not call.completed.wait(timeout):
+            with self._pending_lock:
+                self._pending.pop(request["id"], None)
+            raise LisaException(f"agent is timeout on {request['op']}")
+        error_number: Optional[int] = call.response.get("errno")
+        if error_number is not None:
+            # raise the same error as local calls, like FileNotFoundError.
+            raise OSError(error_number, os.strerror(error_number), request.get("path"))
+        if "error" in call.response:
+            raise LisaException(
+                f"agent failed on {request['op']}: {call.response['error']}"
+            )
+        return call.response
+
+    def _send(self, message: Dict[str, Any]) -> None:
+        line = json.dumps(message, separators=(",", ":")) + "\n"
+        try:
+            with self._send_lock:
+                self._channel.sendall(line.encode("utf-8"))
+        except Exception as identifier:
+            self.close()
+            with self._pending_lock:
+                pending = self._pending.pop(message["id"], None)
+            if pending:
+                pending.close()
+            raise LisaException(f"failed to send request to agent: {identifier}")
+
+    def _read(self) -> None:
+        try:
+            while True:
+                line = self._stdout.readline()
+                if not line:
+                    break
+                message: Dict[str, Any] = json.loads(line)
+                id_: int = message.get("id", -1)
+                with self._pending_lock:
+                    handler = self._pending.get(id_)
+                    if handler and "out" not in message and "err" not in message:
+                        # outputs are followed by the last message of the request.
+                        self._pending.pop(id_)
+                if handler:
+                    handler.on_message(message)
+        finally:
+            self._is_closed = True
+            with self._pending_lock:
+                pending = list(self._pending.values())
+                self._pending.clear()
+            for handler in pending:
+                handler.close()
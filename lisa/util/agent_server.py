@@ -0,0 +1,193 @@
+# Copyright (c) Microsoft Corporation.
+# Licensed under the MIT license.
+
+"""
+The agent runs on a posix node, and it's started by LISA over one SSH channel. It
+reads requests from stdin, and writes responses to stdout. Each message is a line
+of JSON with the id of the request, so many commands can run at the same time.
+Binary data is encoded by base64.
+
+Requests:
+    {"id": 1, "op": "exec", "cmd": ["ls", "-l"], "env": {...}, "cwd": "/tmp",
+        "pty": false}
+    {"id": 2, "op": "kill", "target": 1, "signal": 9}
+    {"id": 3, "op": "read", "path": "/proc/cpuinfo"}
+    {"id": 4, "op": "stat", "path": "/tmp"}
+
+Responses of exec are multiple messages, "out" and "err" are outputs, and "exit"
+is the last one with the exit code. If "pty" is true, outputs are written to a
+pty, so they are all in "out". Other requests have one response with "data",
+"stat", or "error". The "errno" is in the response too, if it's an OSError.
+
+It's copied to nodes and runs by python3, so it uses standard libraries only, and
+must not import any module of LISA.
+"""
+
+import base64
+import json
+import os
+import pty
+import signal
+import subprocess
+import sys
+import threading
+from typing import Any, Dict, List, Tuple
+
+# the exit code, if the command cannot be started.
+START_FAILED_EXIT_CODE = 127
+
+_output_lock = threading.Lock()
+_processes: Dict[int, "subprocess.Popen[bytes]"] = {}
+_processes_lock = threading.Lock()
+
+
+def _send(message: Dict[str, Any]) -> None:
+    line = (json.dumps(message, separators=(",", ":")) + "\n").encode("utf-8")
+    with _output_lock:
+        sys.stdout.buffer.write(line)
+        sys.stdout.buffer.flush()
+
+
+def _encode(data: bytes) -> str:
+    return base64.b64encode(data).decode("ascii")
+
+
+def _forward(id_: int, key: str, fd: int) -> None:
+    while True:
+        try:
+            data = os.read(fd, 65536)
+        except OSError:
+            # reading the pty fails with EIO, after the command exits.
+            break
+        if not data:
+            break
+        _send({"id": id_, key: _encode(data)})
+    os.close(fd)
+
+
+def _exec(request: Dict[str, Any]) -> None:
+    id_: int = request["id"]
+    env = None
+    if request.get("env"):
+        env = dict(os.environ)
+        env.update(request["env"])
+    outputs: List[Tuple[str, int]] = []
+    pty_fd = -1
+    try:
+        if request.get("pty"):
+            pty_fd, terminal_fd = pty.openpty()
+            try:
+                process = subprocess.Popen(
+                    request["cmd"],
+                    stdin=subprocess.DEVNULL,
+                    stdout=terminal_fd,
+                    stderr=terminal_fd,
+                    cwd=request.get("cwd") or None,
+                    env=env,
+                    start_new_session=True,
+                )
+            finally:
+                os.close(terminal_fd)
+            outputs.append(("out", pty_fd))
+        else:
+            process = subprocess.Popen(
+                request["cmd"],
+                stdin=subprocess.DEVNULL,
+                stdout=subprocess.PIPE,
+                stderr=subprocess.PIPE,
+                cwd=request.get("cwd") or None,
+                env=env,
+                # children of the command are killed together, so the pipes are
+                # closed.
+                start_new_session=True,
+            )
+            assert process.stdout and process.stderr
+            outputs.append(("out", os.dup(process.stdout.fileno())))
+            outputs.append(("err", os.dup(process.stderr.fileno())))
+            process.stdout.close()
+            process.stderr.close()
+    except Exception as identifier:
+        if pty_fd >= 0:
+            os.close(pty_fd)
+        _send({"id": id_, "err": _encode(str(identifier).encode("utf-8"))})
+        _send({"id": id_, "exit": START_FAILED_EXIT_CODE})
+        return
+
+    with _processes_lock:
+        _processes[id_] = process
+    readers: List[threading.Thread] = []
+    for key, fd in outputs:
+        reader = threading.Thread(target=_forward, args=(id_, key, fd))
+        reader.daemon = True
+        reader.start()
+        readers.append(reader)
+
+    def _wait() -> None:
+        for reader in readers:
+            reader.join()
+        exit_code = process.wait()
+        with _processes_lock:
+            _processes.pop(id_, None)
+        _send({"id": id_, "exit": exit_code})
+
+    waiter = threading.Thread(target=_wait)
+    waiter.daemon = True
+    waiter.start()
+
+
+def _kill(request: Dict[str, Any]) -> None:
+    with _processes_lock:
+        process = _processes.get(request["target"])
+    if process:
+        try:
+            os.killpg(process.pid, request.get("signal", signal.SIGKILL))
+        except OSError:
+            # it exited already.
+            pass
+
+
+def _read(request: Dict[str, Any]) -> None:
+    with open(request["path"], "rb") as file:
+        _send({"id": request["id"], "data": _encode(file.read())})
+
+
+def _stat(request: Dict[str, Any]) -> None:
+    result = os.stat(request["path"])
+    _send({"id": request["id"], "stat": list(result)[:10]})
+
+
+_handlers = {"exec": _exec, "kill": _kill, "read": _read, "stat": _stat}
+
+
+def main() -> None:
+    # it's ready to receive requests.
+    _send({"id": 0, "ready": os.getpid()})
+    for line in sys.stdin.buffer:
+        if not line.strip():
+            continue
+        request = json.loads(line.decode("utf-8"))
+        try:
+            _handlers[request["op"]](request)
+        except OSError as identifier:
+            _send(
+                {
+                    "id": request.get("id"),
+                    "error": str(identifier),
+                    "errno": identifier.errno,
+                }
+            )
+        except Exception as identifier:
+            _send({"id": request.get("id"), "error": str(identifier)})
+
+    # stdin is closed, when LISA disconnects. Don't leave commands running.
+    with _processes_lock:
+        processes = list(_processes.values())
+    for process in processes:
+        try:
+            os.killpg(process.pid, signal.SIGKILL)
+        except OSError:
+            pass
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,153 @@
+# Copyright (c) Microsoft Corporation.
+# Licensed under the MIT license.
+
+import codecs
+import select
+import shlex
+from threading import Lock, Thread
+from typing import Any, Callable, List, Mapping, Optional, Sequence
+
+import paramiko
+
+from .perf_timer import create_timer
+from .session import SessionResult, is_output_kept
+
+
+def generate_run_command(
+    command: Sequence[str],
+    update_env: Optional[Mapping[str, str]] = None,
+    cwd: Optional[str] = None,
+) -> str:
+    """
+    The first line of stdout is the pid, and then the shell is replaced by the
+    command, so the pid is the pid of the command.
+    """
+    script = "echo $$; "
+    if cwd:
+        script += f"cd {shlex.quote(cwd)} || exit 1; "
+    script += "exec "
+    if update_env:
+        env_args = [f"{key}={value}" for key, value in update_env.items()]
+        script += f"env {' '.join(shlex.quote(x) for x in env_args)} "
+    script += " ".join(shlex.quote(x) for x in command)
+    return f"sh -c {shlex.quote(script)}"
+
+
+class ChannelProcess:
+    """
+    A command, which runs in a paramiko channel. It has the same methods as spur
+    processes, which are used by Process.
+
+    No thread is started for outputs. They are read by the waiting thread, or
+    when the status is checked, so the command isn't blocked on a full window.
+    In the streaming mode, outputs are read by a thread, so lines are handled,
+    even if the process is not waited, and they are not kept in memory.
+    """
+
+    def __init__(
+        self,
+        channel: paramiko.Channel,
+        kill: Callable[[str, int], None],
+        stdout: Any,
+        stderr: Any,
+        encoding: str,
+    ) -> None:
+        self._channel = channel
+        self._kill = kill
+        self._stdout_writer = stdout
+        self._stderr_writer = stderr
+        decoder_type = codecs.getincrementaldecoder(encoding)
+        self._stdout_decoder = decoder_type(errors="replace")
+        self._stderr_decoder = decoder_type(errors="replace")
+        self._stdout: List[str] = []
+        self._stderr: List[str] = []
+        self._lock = Lock()
+        self._pid_buffer = ""
+        self.pid: Optional[str] = None
+        self._is_exited = False
+        self._return_code: int = -1
+        if is_output_kept(stdout):
+            Thread(target=self.wait, daemon=True, name="lisa_channel_reader").start()
+
+    def is_running(self) -> bool:
+        self._read()
+        return not self._is_exited
+
+    def wait(self, timeout: Optional[float] = None) -> bool:
+        timer = create_timer()
+        while not self._is_exited:
+            remaining = 1.0
+            if timeout is not None:
+                remaining = min(timeout - timer.elapsed(False), remaining)
+                if remaining <= 0:
+                    return False
+            # the channel is readable on outputs and the exit status.
+            select.select([self._channel], [], [], remaining)
+            self._read()
+        return True
+
+    def wait_for_result(self) -> SessionResult:
+        self.wait()
+        return SessionResult(
+            output="".join(self._stdout),
+            stderr_output="".join(self._stderr),
+            return_code=self._return_code,
+        )
+
+    def send_signal(self, signal_number: int) -> None:
+        if not self.is_running():
+            return
+        if self.pid:
+            self._kill(self.pid, signal_number)
+        else:
+            # it's not started yet, so close it.
+            self.close()
+
+    def close(self) -> None:
+        self._channel.close()
+
+    def _read(self) -> None:
+        with self._lock:
+            if self._is_exited:
+                return
+            channel = self._channel
+            while channel.recv_ready():
+                self._write_stdout(channel.recv(65536))
+            while channel.recv_stderr_ready():
+                data = self._stderr_decoder.decode(channel.recv_stderr(65536))
+                self._write(data, self._stderr, self._stderr_writer)
+            # outputs are sent before the exit status. They may arrive after
+            # the loops above, so it exits, only when both streams are drained.
+            if (
+                channel.exit_status_ready()
+                and not channel.recv_ready()
+                and not channel.recv_stderr_ready()
+            ):
+                self._return_code = channel.recv_exit_status()
+                self._exit()
+            elif channel.closed:
+                self._exit()
+
+    def _exit(self) -> None:
+        # incomplete characters at the end are flushed by decoders.
+        self._write_stdout(b"", final=True)
+        data = self._stderr_decoder.decode(b"", final=True)
+        self._write(data, self._stderr, self._stderr_writer)
+        self._is_exited = True
+
+    def _write_stdout(self, data: bytes, final: bool = False) -> None:
+        text = self._stdout_decoder.decode(data, final=final)
+        if self.pid is None:
+            self._pid_buffer += text
+            if "\n" not in self._pid_buffer:
+                return
+            pid, text = self._pid_buffer.split("\n", 1)
+            self.pid = pid.strip()
+        self._write(text, self._stdout, self._stdout_writer)
+
+    def _write(self, text: str, outputs: List[str], writer: Any) -> None:
+        if text:
+            if not is_output_kept(writer):
+                outputs.append(text)
+            if writer:
+                writer.write(text)
@@ -0,0 +1,143 @@
+# Copyright (c) Microsoft Corporation.
+# Licensed under the MIT license.
+
+import heapq
+import time
+from concurrent.futures import FIRST_COMPLETED, Executor, Future, wait
+from threading import Event, Lock
+from typing import Any, Callable, Iterable, List, Set, Tuple, TypeVar
+
+T_RESULT = TypeVar("T_RESULT")
+
+
+class Clock:
+    """
+    The clock of tasks. It's the real time by default. The simulation replaces it
+    by a virtual clock, so modeled durations don't take real time.
+
+    Tasks, which may sleep on the clock, are submitted by the clock, and waits on
+    them are told to the clock. So a virtual clock knows, when all tasks are
+    waiting, and time can move on.
+    """
+
+    def time(self) -> float:
+        return time.monotonic()
+
+    def sleep(self, seconds: float) -> None:
+        time.sleep(seconds)
+
+    def submit(
+        self, pool: Executor, task: Callable[[], T_RESULT]
+    ) -> "Future[T_RESULT]":
+        return pool.submit(task)
+
+    def wait(
+        self, futures: Iterable["Future[Any]"], return_when: str = FIRST_COMPLETED
+    ) -> None:
+        wait(futures, return_when=return_when)
+
+
+class _Waiter:
+    def __init__(self, futures: Iterable["Future[Any]"], return_when: str) -> None:
+        self.futures = list(futures)
+        self.return_when = return_when
+        self.event = Event()
+
+    @property
+    def is_ready(self) -> bool:
+        if not self.futures:
+            return True
+        if self.return_when == FIRST_COMPLETED:
+            return any(x.done() for x in self.futures)
+        return all(x.done() for x in self.futures)
+
+
+class VirtualClock(Clock):
+    """
+    It starts at 0, and moves to the next wake up time of sleeping threads, only
+    when no thread is active. A thread is active, if it runs a submitted task, or
+    it's the thread creating the clock, and it doesn't sleep or wait on the clock.
+    So the time is the sum of modeled durations on the critical path, and it
+    doesn't depend on the real time of scheduling.
+
+    Threads waiting on the same time are waken in the order of sleeping.
+    """
+
+    def __init__(self) -> None:
+        self._lock = Lock()
+        self._now: float = 0
+        # the thread, which creates the clock, is active.
+        self._active = 1
+        self._sequence = 0
+        self._sleepers: List[Tuple[float, int, Event]] = []
+        self._waiters: Set[_Waiter] = set()
+
+    def time(self) -> float:
+        return self._now
+
+    def sleep(self, seconds: float) -> None:
+        event = Event()
+        with self._lock:
+            heapq.heappush(self._sleepers, (self._now + seconds, self._sequence, event))
+            self._sequence += 1
+            self._deactivate()
+        event.wait()
+
+    def submit(
+        self, pool: Executor, task: Callable[[], T_RESULT]
+    ) -> "Future[T_RESULT]":
+        # the task is active, before it's started. So time doesn't move, before
+        # it runs to the first sleep.
+        with self._lock:
+            self._active += 1
+        future = pool.submit(task)
+        future.add_done_callback(self._on_done)
+        return future
+
+    def wait(
+        self, futures: Iterable["Future[Any]"], return_when: str = FIRST_COMPLETED
+    ) -> None:
+        waiter = _Waiter(futures, return_when)
+        with self._lock:
+            if not waiter.is_ready:
+                self._waiters.add(waiter)
+                self._deactivate()
+            else:
+                waiter.event.set()
+        waiter.event.wait()
+
+    def _on_done(self, future: "Future[Any]") -> None:
+        with self._lock:
+            # waiters are active, before the task is not. So time doesn't move,
+            # before waiters run.
+            for waiter in [x for x in self._waiters if x.is_ready]:
+                self._waiters.remove(waiter)
+                self._active += 1
+                waiter.event.set()
+            self._deactivate()
+
+    def _deactivate(self) -> None:
+        self._active -= 1
+        assert self._active >= 0, f"active threads is negative: {self._active}"
+        if self._active or not self._sleepers:
+            return
+        self._now = self._sleepers[0][0]
+        while self._sleepers and self._sleepers[0][0] == self._now:
+            _, _, event = heapq.heappop(self._sleepers)
+            self._active += 1
+            event.set()
+
+
+_clock: Clock = Clock()
+
+
+def get_clock() -> Clock:
+    return _clock
+
+
+def set_clock(clock: Clock) -> None:
+    """
+    The virtual clock is set by the simulation, before tasks are started.
+    """
+    global _clock
+    _clock = clock
@@ -3,6 +3,7 @@
 
 import re
 from pathlib import Path, PurePath
+from typing import Optional
 
 # config types
 CONFIG_RUNBOOK = "runbook"
@@ -15,6 +16,9 @@ TEST_PASS = "test_pass"
 TAGS = "tags"
 
 CONCURRENCY = "concurrency"
+SHARD_INDEX = "shard_index"
+SHARD_COUNT = "shard_count"
+DURATION_HISTORY_PATH = "duration_history_path"
 
 RUNBOOK_FILE: Path
 RUNBOOK_PATH: Path
@@ -28,6 +32,9 @@ RUN_LOCAL_PATH: Path = Path()
 # The datetime part of this path is the # same as local path, so it's easy to find
 # remote files, which belongs to same run.
 RUN_LOGIC_PATH: PurePath = PurePath()
+# The path of an interrupted run to resume. Completed cases in its checkpoints
+# are not run again.
+RESUME_PATH: Optional[Path] = None
 
 # path related
 PATH_REMOTE_ROOT = "lisa_working"
@@ -87,10 +94,17 @@ ENVIRONMENTS_NODES_REMOTE_PUBLIC_PORT = "public_port"
 ENVIRONMENTS_NODES_REMOTE_USERNAME = "username"
 ENVIRONMENTS_NODES_REMOTE_PASSWORD = "password"
 ENVIRONMENTS_NODES_REMOTE_PRIVATE_KEY_FILE = "private_key_file"
+ENVIRONMENTS_NODES_REMOTE_MAX_CHANNELS = "max_channels"
+ENVIRONMENTS_NODES_REMOTE_USE_SESSION = "use_session"
+ENVIRONMENTS_NODES_REMOTE_USE_AGENT = "use_agent"
+ENVIRONMENTS_NODES_REMOTE_SHELL_BACKEND = "shell_backend"
+SHELL_BACKEND_SPUR = "spur"
+SHELL_BACKEND_PARAMIKO = "paramiko"
 
 PLATFORM = "platform"
 PLATFORM_READY = "ready"
 PLATFORM_MOCK = "mock"
+PLATFORM_SIMULATION = "simulation"
 
 TESTCASE = "testcase"
 TESTCASE_TYPE_LISA = "lisa"
@@ -0,0 +1,100 @@
+# Copyright (c) Microsoft Corporation.
+# Licensed under the MIT license.
+
+import codecs
+import os
+import subprocess
+from threading import Thread
+from typing import IO, Any, List, Mapping, Optional, Sequence
+
+from .session import SessionResult, is_output_kept
+
+
+class LocalStreamProcess:
+    """
+    A local command in the streaming mode. It has the same methods as spur
+    processes, which are used by Process. spur keeps a copy of the whole output
+    of local processes, so outputs are read by threads here, and they are passed
+    to writers without keeping them, if writers keep them.
+    """
+
+    def __init__(
+        self,
+        command: Sequence[str],
+        update_env: Optional[Mapping[str, str]],
+        cwd: Optional[str],
+        stdout: Any,
+        stderr: Any,
+        encoding: str,
+    ) -> None:
+        env = dict(os.environ)
+        if update_env:
+            env.update(update_env)
+        self._popen = subprocess.Popen(
+            command,
+            cwd=cwd,
+            env=env,
+            stdin=subprocess.DEVNULL,
+            stdout=subprocess.PIPE,
+            stderr=subprocess.PIPE,
+        )
+        self.pid = self._popen.pid
+        self._stdout: List[str] = []
+        self._stderr: List[str] = []
+        assert self._popen.stdout and self._popen.stderr
+        self._readers = [
+            Thread(
+                target=_read,
+                args=(self._popen.stdout, self._stdout, stdout, encoding),
+                daemon=True,
+                name="lisa_local_reader",
+            ),
+            Thread(
+                target=_read,
+                args=(self._popen.stderr, self._stderr, stderr, encoding),
+                daemon=True,
+                name="lisa_local_reader",
+            ),
+        ]
+        for reader in self._readers:
+            reader.start()
+
+    def is_running(self) -> bool:
+        return self._popen.poll() is None
+
+    def wait(self, timeout: Optional[float] = None) -> bool:
+        try:
+            self._popen.wait(timeout=timeout)
+        except subprocess.TimeoutExpired:
+            return False
+        return True
+
+    def wait_for_result(self) -> SessionResult:
+        return_code = self._popen.wait()
+        # outputs are read to the end, after the process exits.
+        for reader in self._readers:
+            reader.join()
+        return SessionResult(
+            output="".join(self._stdout),
+            stderr_output="".join(self._stderr),
+            return_code=return_code,
+        )
+
+    def send_signal(self, signal_number: int) -> None:
+        if self.is_running():
+            self._popen.send_signal(signal_number)
+
+
+def _read(stream: IO[bytes], outputs: List[str], writer: Any, encoding: str) -> None:
+    decoder = codecs.getincrementaldecoder(encoding)(errors="replace")
+    with stream:
+        while True:
+            data = os.read(stream.fileno(), 65536)
+            text = decoder.decode(data, final=not data)
+            if text:
+                if not is_output_kept(writer):
+                    outputs.append(text)
+                if writer:
+                    writer.write(text)
+            if not data:
+                break
@@ -1,10 +1,14 @@
 # Copyright (c) Microsoft Corporation.
 # Licensed under the MIT license.
 
-from concurrent.futures import FIRST_COMPLETED, Future, ThreadPoolExecutor, wait
-from typing import Any, Callable, Generic, List, Optional, TypeVar
+from concurrent.futures import FIRST_COMPLETED, Future, ThreadPoolExecutor
+from queue import Empty, SimpleQueue
+from threading import Lock, local
+from typing import Any, Callable, Dict, Generic, List, Optional, TypeVar
 
 from . import LisaException
+from .clock import VirtualClock, get_clock
+from .perf_timer import Timer, create_timer
 
 T_RESULT = TypeVar("T_RESULT")
 
@@ -13,19 +17,44 @@ class TaskManager(Generic[T_RESULT]):
     def __init__(self, max_workers: int, callback: Callable[[T_RESULT], None]) -> None:
         self._pool = ThreadPoolExecutor(max_workers=max_workers)
         self._max_workers = max_workers
-        self._futures: List[Future[T_RESULT]] = []
+        # running futures and the owner, which submits the task.
+        self._futures: Dict[Future[T_RESULT], Any] = {}
+        # futures out of the pool, and the owner, which waits for them. They wake
+        # up the owner, but they don't use workers, and results are not passed to
+        # the callback.
+        self._watched_futures: Dict[Future[Any], Any] = {}
+        # futures are put by done callbacks, so the waiter is waken up once a task
+        # is completed. It doesn't need to scan all running futures.
+        self._completed_queue: SimpleQueue[Future[Any]] = SimpleQueue()
         self._callback = callback
         self._cancelled = False
 
+        # the scheduling overhead is the time between waking up from waiting, and
+        # starting next waiting.
+        self.scheduler_passes: int = 0
+        self.scheduler_overhead: float = 0
+        self._pass_timer: Optional[Timer] = None
+
     def __enter__(self) -> Any:
         return self._pool.__enter__()
 
     def __exit__(self, exc_type: Any, exc_val: Any, exc_tb: Any) -> Optional[bool]:
         return self._pool.__exit__(exc_type, exc_val, exc_tb)
 
-    def submit_task(self, task: Callable[[], T_RESULT]) -> None:
-        future: Future[T_RESULT] = self._pool.submit(task)
-        self._futures.append(future)
+    def submit_task(self, task: Callable[[], T_RESULT], owner: Any = None) -> None:
+        """
+        owner: it's returned by wait_completed, when the task is completed. So the
+            caller knows who may have more tasks to schedule.
+        """
+        future: Future[T_RESULT] = get_clock().submit(self._pool, task)
+        self._futures[future] = owner
+        future.add_done_callback(self._completed_queue.put)
+
+    def watch_future(self, future: Future[Any], owner: Any) -> None:
+        if future in self._watched_futures:
+            return
+        self._watched_futures[future] = owner
+        future.add_done_callback(self._completed_queue.put)
 
     def cancel(self) -> None:
         self._cancelled = True
@@ -37,21 +66,69 @@ class TaskManager(Generic[T_RESULT]):
     def has_idle_worker(self) -> bool:
         return len(self._futures) < self._max_workers
 
-    def wait_worker(self) -> bool:
+    @property
+    def has_running_task(self) -> bool:
+        return len(self._futures) > 0 or len(self._watched_futures) > 0
+
+    @property
+    def average_scheduler_overhead(self) -> float:
+        if not self.scheduler_passes:
+            return 0
+        return self.scheduler_overhead / self.scheduler_passes
+
+    def wait_completed(self) -> List[Any]:
         """
+        Block until a running task is completed, and then collect all other
+        completed tasks without blocking.
+
         Return:
-            True, if there is running worker.
+            owners of completed tasks, in completed order. It's empty, if there is
+            no running task.
         """
-
-        done_futures, _ = wait(self._futures[:], return_when=FIRST_COMPLETED)
-        for future in done_futures:
-            # join exceptions of subthreads to main thread
-            result = future.result()
-            # removed finished threads
-            self._futures.remove(future)
-            # exception will throw at this point
-            self._callback(result)
-        return len(self._futures) > 0
+        self._stop_pass_timer()
+
+        owners: List[Any] = []
+        if self.has_running_task:
+            try:
+                future = self._completed_queue.get_nowait()
+            except Empty:
+                clock = get_clock()
+                if isinstance(clock, VirtualClock):
+                    # the wait is told to the virtual clock, so it can move on,
+                    # when all tasks are sleeping. In real time, it only blocks
+                    # on the queue, without scanning running futures.
+                    clock.wait(
+                        [*self._futures, *self._watched_futures],
+                        return_when=FIRST_COMPLETED,
+                    )
+                future = self._completed_queue.get()
+            while True:
+                owners.append(self._handle_completed(future))
+                try:
+                    future = self._completed_queue.get_nowait()
+                except Empty:
+                    break
+
+        self._pass_timer = create_timer()
+        return owners
+
+    def _handle_completed(self, future: Future[T_RESULT]) -> Any:
+        if future in self._watched_futures:
+            # the result is handled by the owner.
+            return self._watched_futures.pop(future)
+        # removed finished threads
+        owner = self._futures.pop(future)
+        # join exceptions of subthreads to main thread
+        result = future.result()
+        # exception will throw at this point
+        self._callback(result)
+        return owner
+
+    def _stop_pass_timer(self) -> None:
+        if self._pass_timer:
+            self.scheduler_overhead += self._pass_timer.elapsed()
+            self.scheduler_passes += 1
+            self._pass_timer = None
 
 
 _default_task_manager: Optional[TaskManager[Any]] = None
@@ -71,3 +148,82 @@ def cancel() -> None:
 def check_cancelled() -> None:
     if _default_task_manager:
         _default_task_manager.check_cancelled()
+
+
+class ParallelException(LisaException):
+    """
+    It's raised, when some of parallel tasks failed. Results of other tasks are
+    kept, the failed ones are None.
+    """
+
+    def __init__(
+        self, names: List[str], results: List[Any], exceptions: Dict[int, Exception]
+    ) -> None:
+        self.results = results
+        self.exceptions = exceptions
+        messages = [
+            f"{names[index]}: {exception.__class__.__name__}: {exception}"
+            for index, exception in exceptions.items()
+        ]
+        super().__init__(
+            f"{len(exceptions)} of {len(results)} tasks failed. {'; '.join(messages)}"
+        )
+
+
+# the shared pool of run_in_parallel. It's bounded, so many nodes won't create too
+# many connections at the same time.
+_max_parallel_workers = 16
+_parallel_pool: Optional[ThreadPoolExecutor] = None
+_parallel_pool_lock = Lock()
+_parallel_thread = local()
+
+
+def _get_parallel_pool() -> ThreadPoolExecutor:
+    global _parallel_pool
+    with _parallel_pool_lock:
+        if _parallel_pool is None:
+            _parallel_pool = ThreadPoolExecutor(
+                max_workers=_max_parallel_workers, thread_name_prefix="lisa_parallel"
+            )
+        return _parallel_pool
+
+
+def _run_in_pool(task: Callable[[], T_RESULT]) -> T_RESULT:
+    _parallel_thread.is_in_pool = True
+    return task()
+
+
+def run_in_parallel(
+    tasks: List[Callable[[], T_RESULT]], names: Optional[List[str]] = None
+) -> List[T_RESULT]:
+    """
+    Run tasks in the shared pool, and wait all of them completed. Results are in
+    the same order of tasks. If any task failed, a ParallelException is raised
+    after all tasks completed.
+
+    names: names of tasks, they are used in the error message.
+    """
+    results: List[Any] = [None] * len(tasks)
+    exceptions: Dict[int, Exception] = {}
+    # nested calls run in the current thread, since waiting on the bounded pool
+    # from its own threads may deadlock.
+    if len(tasks) <= 1 or getattr(_parallel_thread, "is_in_pool", False):
+        for index, task in enumerate(tasks):
+            try:
+                results[index] = task()
+            except Exception as identifier:
+                exceptions[index] = identifier
+    else:
+        pool = _get_parallel_pool()
+        futures = [pool.submit(_run_in_pool, task) for task in tasks]
+        for index, future in enumerate(futures):
+            try:
+                results[index] = future.result()
+            except Exception as identifier:
+                exceptions[index] = identifier
+
+    if exceptions:
+        if names is None:
+            names = [str(index) for index in range(len(tasks))]
+        raise ParallelException(names, results, exceptions)
+    return results
@@ -0,0 +1,209 @@
+# Copyright (c) Microsoft Corporation.
+# Licensed under the MIT license.
+
+import errno
+import random
+import selectors
+import socket
+import time
+from threading import Event, Lock, Thread
+from typing import List, Optional, Tuple, cast
+
+from . import LisaException
+from .logger import Logger
+
+# the delay before next try increases from the initial delay to the max delay. The
+# max delay is short, so a port is found soon after it's opened.
+_initial_delay = 0.1
+_max_delay = 1.0
+# a connecting attempt is given up, if there is no response in the time. Some
+# nodes drop SYN packets on booting, so a new attempt is faster than waiting for
+# retransmissions of the kernel.
+_connect_timeout = 2.0
+
+_in_progress_codes = {errno.EINPROGRESS, errno.EWOULDBLOCK, errno.EAGAIN}
+
+
+class _Target:
+    def __init__(
+        self,
+        address: str,
+        port: int,
+        socket_address: Tuple[str, int],
+        log: Optional[Logger],
+    ) -> None:
+        self.address = address
+        self.port = port
+        self.socket_address = socket_address
+        self.log = log
+        self.is_ready = False
+        self.error_code = 0
+        self.attempts = 0
+        self.next_time = time.monotonic()
+        self.connect_deadline = 0.0
+        self.socket: Optional[socket.socket] = None
+        self.is_cancelled = False
+        self.completed = Event()
+
+
+class TcpPortProber:
+    """
+    It checks TCP ports of many nodes in one thread by non-blocking connecting and
+    select (epoll on Linux). Each waiter is waken up, once its port is connected.
+    Failed attempts are retried in jittered exponential backoff, so nodes are not
+    probed at the same pace.
+    """
+
+    def __init__(self) -> None:
+        self._lock = Lock()
+        self._targets: List[_Target] = []
+        self._thread: Optional[Thread] = None
+        self._selector = selectors.DefaultSelector()
+        # it wakes up the selector, when targets are added or cancelled.
+        self._wakeup_reader, self._wakeup_writer = socket.socketpair()
+        self._wakeup_reader.setblocking(False)
+        self._selector.register(self._wakeup_reader, selectors.EVENT_READ)
+
+    def wait(
+        self,
+        address: str,
+        port: int,
+        timeout: float,
+        log: Optional[Logger] = None,
+    ) -> Tuple[bool, int]:
+        """
+        return is ready or not, and the error code of the last attempt.
+        """
+        # TODO: may need to support IPv6.
+        try:
+            address_info = socket.getaddrinfo(
+                address, port, socket.AF_INET, socket.SOCK_STREAM
+            )
+        except Exception as identifier:
+            raise LisaException(f"failed to connect to {address}:{port}: {identifier}")
+        socket_address = cast(Tuple[str, int], address_info[0][4])
+        target = _Target(address, port, socket_address, log)
+
+        with self._lock:
+            self._targets.append(target)
+            if self._thread is None:
+                self._thread = Thread(
+                    target=self._run, name="lisa_tcp_prober", daemon=True
+                )
+                self._thread.start()
+        self._wake_up()
+
+        target.completed.wait(timeout)
+        if not target.completed.is_set():
+            target.is_cancelled = True
+            self._wake_up()
+        return target.is_ready, target.error_code
+
+    def _wake_up(self) -> None:
+        self._wakeup_writer.send(b"\0")
+
+    def _run(self) -> None:
+        while True:
+            with self._lock:
+                self._targets = [x for x in self._targets if not self._clean_up(x)]
+                if not self._targets:
+                    self._thread = None
+                    return
+                targets = list(self._targets)
+
+            now = time.monotonic()
+            wait_until = now + _max_delay
+            for target in targets:
+                if target.socket is None:
+                    if now >= target.next_time:
+                        self._connect(target)
+                elif now >= target.connect_deadline:
+                    self._fail(target, errno.ETIMEDOUT)
+                wait_until = min(
+                    wait_until,
+                    target.connect_deadline if target.socket else target.next_time,
+                )
+
+            for key, _ in self._selector.select(max(wait_until - now, 0)):
+                if key.data is None:
+                    self._drain_wakeup()
+                else:
+                    self._check_connected(key.data)
+
+    def _connect(self, target: _Target) -> None:
+        target.attempts += 1
+        tcp_socket = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        tcp_socket.setblocking(False)
+        result = tcp_socket.connect_ex(target.socket_address)
+        if result == 0:
+            tcp_socket.close()
+            self._complete(target)
+        elif result in _in_progress_codes or result == 10035:
+            # 10035 is WSAEWOULDBLOCK on Windows.
+            target.socket = tcp_socket
+            target.connect_deadline = time.monotonic() + _connect_timeout
+            self._selector.register(tcp_socket, selectors.EVENT_WRITE, target)
+        else:
+            tcp_socket.close()
+            self._fail(target, result)
+
+    def _check_connected(self, target: _Target) -> None:
+        assert target.socket
+        result = target.socket.getsockopt(socket.SOL_SOCKET, socket.SO_ERROR)
+        self._close_socket(target)
+        if result == 0:
+            self._complete(target)
+        else:
+            self._fail(target, result)
+
+    def _complete(self, target: _Target) -> None:
+        target.is_ready = True
+        target.error_code = 0
+        target.completed.set()
+
+    def _fail(self, target: _Target, error_code: int) -> None:
+        self._close_socket(target)
+        target.error_code = error_code
+        delay = min(_initial_delay * 2 ** (target.attempts - 1), _max_delay)
+        # the jitter is in the upper half, so the delay still grows.
+        target.next_time = time.monotonic() + random.uniform(delay / 2, delay)
+        if target.attempts % 10 == 1 and target.log:
+            target.log.debug(
+                f"cannot connect to {target.address}:{target.port}, "
+                f"error code: {error_code}, current try: {target.attempts}. "
+                f"retrying..."
+            )
+
+    def _close_socket(self, target: _Target) -> None:
+        if target.socket:
+            self._selector.unregister(target.socket)
+            target.socket.close()
+            target.socket = None
+
+    def _clean_up(self, target: _Target) -> bool:
+        """
+        return True, if the target is completed or cancelled, so it can be removed.
+        """
+        if target.completed.is_set() or target.is_cancelled:
+            self._close_socket(target)
+            return True
+        return False
+
+    def _drain_wakeup(self) -> None:
+        try:
+            while self._wakeup_reader.recv(1024):
+                pass
+        except (BlockingIOError, InterruptedError):
+            pass
+
+
+_prober: Optional[TcpPortProber] = None
+_prober_lock = Lock()
+
+
+def get_tcp_port_prober() -> TcpPortProber:
+    global _prober
+    with _prober_lock:
+        if _prober is None:
+            _prober = TcpPortProber()
+        return _prober
@@ -1,22 +1,34 @@
 # Copyright (c) Microsoft Corporation.
 # Licensed under the MIT license.
 
+import asyncio
 import logging
 import pathlib
 import shlex
 import signal
 import subprocess
 import time
+import uuid
 from dataclasses import dataclass
-from typing import Dict, List, Optional, Union
+from typing import Any, Callable, Dict, Generator, List, Optional, TextIO, Union
 
 import spur  # type: ignore
 from assertpy.assertpy import AssertionBuilder, assert_that
 from spur.errors import NoSuchCommandError  # type: ignore
 
+from lisa.util.agent import AgentProcess
+from lisa.util.channel_process import ChannelProcess
+from lisa.util.local_process import LocalStreamProcess
 from lisa.util.logger import Logger, LogWriter, get_logger
 from lisa.util.perf_timer import create_timer
-from lisa.util.shell import Shell
+from lisa.util.session import SessionProcess
+from lisa.util.shell import ChannelBusyError, Shell, SshShell, is_in_event_loop
+
+
+def _set_future_done(future: "asyncio.Future[None]") -> None:
+    # it may be cancelled by timeout.
+    if not future.done():
+        future.set_result(None)
 
 
 @dataclass
@@ -26,6 +38,9 @@ class ExecutableResult:
     exit_code: Optional[int]
     cmd: Union[str, List[str]]
     elapsed: float
+    # in the streaming mode, the full stdout is saved in the file, if it's too
+    # large to keep in memory. The stdout field has the beginning part only.
+    stdout_path: Optional[pathlib.Path] = None
 
     def __str__(self) -> str:
         return self.stdout
@@ -43,6 +58,177 @@ class ExecutableResult:
         return assert_that(self.stderr, message).is_equal_to(expected_stderr)
 
 
+# max characters of stdout in memory in the streaming mode.
+STREAM_MEMORY_LIMIT = 1024 * 1024
+
+
+class OutputStream:
+    """
+    It's the stdout writer in the streaming mode. Each line is passed to the
+    handler, when it's received. So parsers don't need to wait for the whole
+    output. The handler is called in the reading thread.
+
+    The output is kept in memory and logged, until it reaches the limit. After
+    that, all output is saved to a file in the log path, instead of logging it.
+    """
+
+    # processes of streaming commands don't keep another copy.
+    keeps_output = True
+
+    def __init__(
+        self,
+        log_writer: LogWriter,
+        line_handler: Optional[Callable[[str], None]],
+        spill_path: Optional[pathlib.Path],
+        log: Logger,
+        memory_limit: int = STREAM_MEMORY_LIMIT,
+    ) -> None:
+        self._log_writer = log_writer
+        self._line_handler = line_handler
+        self._spill_path = spill_path
+        self._log = log
+        self._memory_limit = memory_limit
+        self._outputs: List[str] = []
+        self._output_size = 0
+        self._line_buffer = ""
+        self._spill_file: Optional[TextIO] = None
+        self.spilled_path: Optional[pathlib.Path] = None
+
+    @property
+    def output(self) -> str:
+        return "".join(self._outputs)
+
+    def write(self, text: str) -> None:
+        self._save(text)
+        if self._line_handler:
+            self._line_buffer += text
+            if "\n" in text:
+                *lines, self._line_buffer = self._line_buffer.split("\n")
+                for line in lines:
+                    self._line_handler(line.rstrip("\r"))
+
+    def close(self) -> None:
+        if self._line_handler and self._line_buffer:
+            self._line_handler(self._line_buffer.rstrip("\r"))
+            self._line_buffer = ""
+        if self._spill_file:
+            self._spill_file.close()
+            self._spill_file = None
+        self._log_writer.close()
+
+    def _save(self, text: str) -> None:
+        if self._spill_file is None:
+            if self._output_size + len(text) <= self._memory_limit or (
+                not self._spill_path
+            ):
+                self._keep(text)
+                return
+            # fill the memory to the limit, and save the rest to the file.
+            remaining = self._memory_limit - self._output_size
+            self._keep(text[:remaining])
+            self._start_spill()
+            text = text[remaining:]
+        assert self._spill_file
+        self._spill_file.write(text)
+
+    def _keep(self, text: str) -> None:
+        self._outputs.append(text)
+        self._output_size += len(text)
+        self._log_writer.write(text)
+
+    def _start_spill(self) -> None:
+        assert self._spill_path
+        self._spill_path.mkdir(parents=True, exist_ok=True)
+        self.spilled_path = self._spill_path / f"stdout_{uuid.uuid4().hex[:8]}.log"
+        self._log_writer.flush()
+        self._log.debug(
+            f"stdout is larger than {self._memory_limit} characters, "
+            f"the full output is saved to '{self.spilled_path}'"
+        )
+        self._spill_file = open(self.spilled_path, "w", encoding="utf-8", newline="")
+        # the file has full output, and the memory keeps the beginning part.
+        self._spill_file.write(self.output)
+
+
+class CommandBatch:
+    """
+    It runs commands one by one in a posix shell script, so they take one round
+    trip. Each command runs in its own shell. The stdout, stderr, exit code and
+    the time on node of each command are framed by sentinels in the stdout of the
+    script, so they can be separated, even if stdout and stderr are merged by pty.
+    """
+
+    def __init__(self, commands: List[str]) -> None:
+        self.commands = commands
+        self._id = uuid.uuid4().hex
+
+    @property
+    def script(self) -> str:
+        lines = ["_lisa_stderr=$(mktemp)"]
+        for index, command in enumerate(self.commands):
+            sentinel = self._get_sentinel(index)
+            lines.extend(
+                [
+                    f"printf '%s\\n' {sentinel}_begin:$(date +%s.%N)",
+                    f'sh -c {shlex.quote(command)} </dev/null 2>"$_lisa_stderr"',
+                    "_lisa_code=$?",
+                    f"printf '%s\\n' {sentinel}_end:$_lisa_code:$(date +%s.%N)",
+                    'cat "$_lisa_stderr"',
+                    f"printf '%s\\n' {sentinel}_stderr",
+                ]
+            )
+        lines.append('rm -f "$_lisa_stderr"')
+        return "\n".join(lines)
+
+    def parse(self, result: ExecutableResult) -> List[ExecutableResult]:
+        """
+        If the script is killed, the remaining commands have no exit code.
+        """
+        output = result.stdout.replace("\r\n", "\n")
+        results: List[ExecutableResult] = []
+        for index, command in enumerate(self.commands):
+            sentinel = self._get_sentinel(index)
+            stdout = ""
+            stderr = ""
+            exit_code: Optional[int] = None
+            elapsed: float = 0
+            begin = output.find(f"{sentinel}_begin:")
+            if begin >= 0:
+                begin_line_end = output.find("\n", begin)
+                begin_time = output[begin + len(sentinel) + 7 : begin_line_end]
+                end = output.find(f"{sentinel}_end:", begin_line_end)
+                if end < 0:
+                    stdout = output[begin_line_end + 1 :]
+                else:
+                    stdout = output[begin_line_end + 1 : end]
+                    end_line_end = output.find("\n", end)
+                    end_values = output[end + len(sentinel) + 5 : end_line_end]
+                    exit_code_str, _, end_time = end_values.partition(":")
+                    exit_code = int(exit_code_str)
+                    elapsed = _get_elapsed(begin_time, end_time)
+                    stderr_end = output.find(f"{sentinel}_stderr", end_line_end)
+                    if stderr_end >= 0:
+                        stderr = output[end_line_end + 1 : stderr_end]
+                        output = output[stderr_end:]
+            results.append(
+                ExecutableResult(
+                    stdout.strip(), stderr.strip(), exit_code, command, elapsed
+                )
+            )
+        return results
+
+    def _get_sentinel(self, index: int) -> str:
+        return f"__lisa_batch_{self._id}_{index}"
+
+
+def _get_elapsed(begin_time: str, end_time: str) -> float:
+    # %N is not supported by date of some distros, so the elapsed time is 0.
+    try:
+        return float(end_time) - float(begin_time)
+    except ValueError:
+        return 0
+
+
 # TODO: So much cleanup here. It was using duck typing.
 class Process:
     def __init__(
@@ -59,6 +245,8 @@ class Process:
         self._log = get_logger("cmd", id_, parent=parent_logger)
         self._process: Optional[spur.local.LocalProcess] = None
         self._result: Optional[ExecutableResult] = None
+        # arguments of the spawn, which waits for a free channel in a loop.
+        self._pending_spawn: Optional[Dict[str, Any]] = None
 
     def start(
         self,
@@ -69,10 +257,109 @@ class Process:
         new_envs: Optional[Dict[str, str]] = None,
         no_error_log: bool = False,
         no_info_log: bool = False,
+        line_handler: Optional[Callable[[str], None]] = None,
+        spill_path: Optional[pathlib.Path] = None,
     ) -> None:
         """
         command include all parameters also.
+
+        line_handler: it enables the streaming mode. Each line of stdout is passed
+            to it, when the line is received.
+        spill_path: the folder to save stdout, if it's too large in the streaming
+            mode. spur keeps a copy of the whole output, so streaming commands
+            don't run by spur on local and remote posix nodes, and the memory is
+            bounded whatever the shell backend is.
+
+        In a running loop, if there is no free channel, the command is spawned,
+        when the process is awaited. So coroutines can start more commands than
+        channels, like "await asyncio.gather(*[node.execute_async(x) ...])".
         """
+        spawn_kwargs = self._prepare(
+            command,
+            shell=shell,
+            sudo=sudo,
+            cwd=cwd,
+            new_envs=new_envs,
+            no_error_log=no_error_log,
+            no_info_log=no_info_log,
+            line_handler=line_handler,
+            spill_path=spill_path,
+        )
+        try:
+            self._spawn(spawn_kwargs)
+        except ChannelBusyError as identifier:
+            if not is_in_event_loop():
+                raise identifier
+            self._pending_spawn = spawn_kwargs
+            self._running = True
+
+    async def start_async(
+        self,
+        command: str,
+        shell: bool = False,
+        sudo: bool = False,
+        cwd: Optional[pathlib.PurePath] = None,
+        new_envs: Optional[Dict[str, str]] = None,
+        no_error_log: bool = False,
+        no_info_log: bool = False,
+        line_handler: Optional[Callable[[str], None]] = None,
+        spill_path: Optional[pathlib.Path] = None,
+    ) -> None:
+        """
+        The coroutine version of start. On remote nodes, a free channel is waited
+        in the loop, and the command is spawned in a thread of the loop executor.
+        """
+        spawn_kwargs = self._prepare(
+            command,
+            shell=shell,
+            sudo=sudo,
+            cwd=cwd,
+            new_envs=new_envs,
+            no_error_log=no_error_log,
+            no_info_log=no_info_log,
+            line_handler=line_handler,
+            spill_path=spill_path,
+        )
+        await self._spawn_async(spawn_kwargs)
+
+    def wait_result(self, timeout: float = 600) -> ExecutableResult:
+        spawn_kwargs = self._pop_pending_spawn()
+        if spawn_kwargs:
+            self._spawn(spawn_kwargs)
+        is_exited = self._wait_exited(timeout)
+        return self._get_result(is_exited, timeout)
+
+    async def wait_result_async(self, timeout: float = 600) -> ExecutableResult:
+        """
+        Wait for the result in asyncio. It doesn't block the event loop, so one
+        loop can wait for commands on many nodes, like by asyncio.gather. If the
+        process is started in the loop without a free channel, it's spawned here,
+        once a channel is free.
+        """
+        spawn_kwargs = self._pop_pending_spawn()
+        if spawn_kwargs:
+            await self._spawn_async(spawn_kwargs)
+        is_exited = await self._wait_exited_async(timeout)
+        return self._get_result(is_exited, timeout)
+
+    def __await__(self) -> Generator[Any, None, ExecutableResult]:
+        """
+        A process can be awaited, like "await node.execute_async(...)".
+        """
+        return self.wait_result_async().__await__()
+
+    def _prepare(
+        self,
+        command: str,
+        shell: bool,
+        sudo: bool,
+        cwd: Optional[pathlib.PurePath],
+        new_envs: Optional[Dict[str, str]],
+        no_error_log: bool,
+        no_info_log: bool,
+        line_handler: Optional[Callable[[str], None]],
+        spill_path: Optional[pathlib.Path],
+    ) -> Dict[str, Any]:
         stdout_level = logging.INFO
         stderr_level = logging.ERROR
         if no_info_log:
@@ -84,6 +371,16 @@ class Process:
         self.stderr_logger = get_logger("stderr", parent=self._log)
         self._stdout_writer = LogWriter(logger=self.stdout_logger, level=stdout_level)
         self._stderr_writer = LogWriter(logger=self.stderr_logger, level=stderr_level)
+        self._stdout_stream: Optional[OutputStream] = None
+        stdout_writer: Union[LogWriter, OutputStream] = self._stdout_writer
+        if line_handler:
+            self._stdout_stream = OutputStream(
+                log_writer=self._stdout_writer,
+                line_handler=line_handler,
+                spill_path=spill_path,
+                log=self._log,
+            )
+            stdout_writer = self._stdout_stream
 
         # command may be Path object, convert it to str
         command = str(command)
@@ -118,78 +415,125 @@ class Process:
         if new_envs is None:
             new_envs = {}
 
+        # save for logging.
+        self._cmd = split_command
+        self._stderr_level = stderr_level
+        self._timer = create_timer()
+        return {
+            "command": split_command,
+            "stdout": stdout_writer,
+            "stderr": self._stderr_writer,
+            "cwd": cwd_path,
+            "update_env": new_envs,
+            "allow_error": True,
+            "store_pid": self._is_posix,
+            "encoding": "utf-8",
+        }
+
+    def _spawn(self, spawn_kwargs: Dict[str, Any]) -> None:
         try:
-            self._timer = create_timer()
-            self._process = self._shell.spawn(
-                command=split_command,
-                stdout=self._stdout_writer,
-                stderr=self._stderr_writer,
-                cwd=cwd_path,
-                update_env=new_envs,
-                allow_error=True,
-                store_pid=self._is_posix,
-                encoding="utf-8",
-            )
-            # save for logging.
-            self._cmd = split_command
+            self._process = self._shell.spawn(**spawn_kwargs)
             self._running = True
         except (FileNotFoundError, NoSuchCommandError) as identifier:
-            # FileNotFoundError: not found command on Windows
-            # NoSuchCommandError: not found command on remote Posix
-            self._result = ExecutableResult(
-                "", identifier.strerror, 1, split_command, self._timer.elapsed()
-            )
-            self._log.log(stderr_level, f"not found command: {identifier}")
+            self._set_not_found(identifier)
 
-    def wait_result(self, timeout: float = 600) -> ExecutableResult:
-        timer = create_timer()
+    async def _spawn_async(self, spawn_kwargs: Dict[str, Any]) -> None:
+        if not isinstance(self._shell, SshShell):
+            # local commands are spawned without waiting.
+            self._spawn(spawn_kwargs)
+            return
+        try:
+            self._process = await self._shell.spawn_async(**spawn_kwargs)
+            self._running = True
+        except (FileNotFoundError, NoSuchCommandError) as identifier:
+            self._set_not_found(identifier)
+
+    def _set_not_found(
+        self, identifier: Union[FileNotFoundError, NoSuchCommandError]
+    ) -> None:
+        # FileNotFoundError: not found command on Windows
+        # NoSuchCommandError: not found command on remote Posix
+        self._result = ExecutableResult(
+            "", identifier.strerror, 1, self._cmd, self._timer.elapsed()
+        )
+        self._log.log(self._stderr_level, f"not found command: {identifier}")
 
-        while self.is_running() and timeout >= timer.elapsed(False):
-            time.sleep(0.01)
+    def _pop_pending_spawn(self) -> Optional[Dict[str, Any]]:
+        spawn_kwargs = self._pending_spawn
+        self._pending_spawn = None
+        return spawn_kwargs
 
-        if timeout < timer.elapsed():
+    def _get_result(self, is_exited: bool, timeout: float) -> ExecutableResult:
+        if not is_exited:
             if self._process is not None:
                 self._log.info(f"timeout in {timeout} sec, and killed")
             self.kill()
 
         if self._result is None:
             assert self._process
-            process_result = self._process.wait_for_result()
+            try:
+                process_result = self._process.wait_for_result()
+            finally:
+                # the channel is released, even if the connection is broken.
+                self._close_process()
             self._stdout_writer.close()
             self._stderr_writer.close()
+            stdout: str = process_result.output
+            stdout_path: Optional[pathlib.Path] = None
+            if self._stdout_stream:
+                self._stdout_stream.close()
+                stdout = self._stdout_stream.output
+                stdout_path = self._stdout_stream.spilled_path
             # cache for future queries, in case it's queried twice.
             self._result = ExecutableResult(
-                process_result.output.strip(),
+                stdout.strip(),
                 process_result.stderr_output.strip(),
                 process_result.return_code,
                 self._cmd,
                 self._timer.elapsed(),
+                stdout_path=stdout_path,
             )
-            # TODO: The spur library is not very good and leaves open
-            # resources (probably due to it starting the process with
-            # `bufsize=0`). We need to replace it, but for now, we
-            # manually close the leaks.
-            if isinstance(self._process, spur.local.LocalProcess):
-                popen: subprocess.Popen[str] = self._process._subprocess
-                if popen.stdin:
-                    popen.stdin.close()
-                if popen.stdout:
-                    popen.stdout.close()
-                if popen.stderr:
-                    popen.stderr.close()
-            elif isinstance(self._process, spur.ssh.SshProcess):
-                if self._process._stdin:
-                    self._process._stdin.close()
-                if self._process._stdout:
-                    self._process._stdout.close()
-                if self._process._stderr:
-                    self._process._stderr.close()
-            self._process = None
             self._log.debug(f"waited with {self._timer}")
 
         return self._result
 
+    def _close_process(self) -> None:
+        # TODO: The spur library is not very good and leaves open
+        # resources (probably due to it starting the process with
+        # `bufsize=0`). We need to replace it, but for now, we
+        # manually close the leaks.
+        process = self._process
+        if isinstance(process, spur.local.LocalProcess):
+            popen: subprocess.Popen[str] = process._subprocess
+            if popen.stdin:
+                popen.stdin.close()
+            if popen.stdout:
+                popen.stdout.close()
+            if popen.stderr:
+                popen.stderr.close()
+        elif isinstance(process, spur.ssh.SshProcess):
+            if process._stdin:
+                process._stdin.close()
+            if process._stdout:
+                process._stdout.close()
+            if process._stderr:
+                process._stderr.close()
+            # the channel is closed, so others can use it.
+            assert isinstance(self._shell, SshShell)
+            self._shell.release_channel(process)
+        elif isinstance(process, ChannelProcess):
+            process.close()
+            assert isinstance(self._shell, SshShell)
+            self._shell.release_channel(process)
+        self._process = None
+
     def kill(self) -> None:
+        if self._pop_pending_spawn():
+            # it's not spawned yet, so it's not spawned anymore.
+            self._running = False
+            self._result = ExecutableResult(
+                "", "killed before started", None, self._cmd, self._timer.elapsed()
+            )
         if self._process:
             if self._shell.is_remote:
                 # Support remote Posix so far
@@ -199,6 +543,77 @@ class Process:
                 # the value is different between windows and posix
                 self._process.send_signal(signal.SIGTERM)
 
+    def _wait_exited(self, timeout: float) -> bool:
+        """
+        Wait on the exit event of the local process or the ssh channel, so it
+        returns once the process exits, instead of polling the status.
+
+        return True, if the process exited in the timeout.
+        """
+        if not self._running or not self._process:
+            return True
+
+        if isinstance(
+            self._process,
+            (SessionProcess, AgentProcess, ChannelProcess, LocalStreamProcess),
+        ):
+            if not self._process.wait(timeout):
+                return False
+        elif isinstance(self._process, spur.local.LocalProcess):
+            popen: subprocess.Popen[str] = self._process._subprocess
+            try:
+                popen.wait(timeout=timeout)
+            except subprocess.TimeoutExpired:
+                return False
+        elif isinstance(self._process, spur.ssh.SshProcess):
+            # the event is set by paramiko, when the exit status is received.
+            if not self._process._channel.status_event.wait(timeout=timeout):
+                return False
+        else:
+            timer = create_timer()
+            while self.is_running():
+                if timer.elapsed(False) > timeout:
+                    return False
+                time.sleep(0.01)
+
+        self._running = False
+        return True
+
+    async def _wait_exited_async(self, timeout: float) -> bool:
+        """
+        The async version of _wait_exited. No thread is used to wait.
+        """
+        if not self._running or not self._process:
+            return True
+
+        if isinstance(self._process, (SessionProcess, AgentProcess)):
+            # the process is set exited by the reader thread of the session or
+            # agent, and it completes the future in the loop.
+            loop = asyncio.get_running_loop()
+            exited: asyncio.Future[None] = loop.create_future()
+
+            def _on_exited() -> None:
+                loop.call_soon_threadsafe(_set_future_done, exited)
+
+            self._process.add_exit_callback(_on_exited)
+            try:
+                await asyncio.wait_for(exited, timeout)
+            except asyncio.TimeoutError:
+                return False
+        else:
+            # spur processes don't notify on exiting, so they are polled in the
+            # loop. The interval increases, so short commands return fast.
+            timer = create_timer()
+            interval = 0.001
+            while self.is_running():
+                if timer.elapsed(False) > timeout:
+                    return False
+                await asyncio.sleep(interval)
+                interval = min(interval * 2, 0.05)
+
+        self._running = False
+        return True
+
     def is_running(self) -> bool:
         if self._running and self._process:
             self._running = self._process.is_running()
@@ -0,0 +1,331 @@
+# Copyright (c) Microsoft Corporation.
+# Licensed under the MIT license.
+
+import codecs
+import select
+import shlex
+import uuid
+from dataclasses import dataclass
+from threading import Event, Lock, Thread
+from typing import Any, Callable, List, Mapping, Optional, Sequence
+
+import paramiko
+
+from lisa.util import LisaException
+
+# the exit code, if the session is closed before the command exits.
+SESSION_CLOSED_EXIT_CODE = -1
+
+
+class ExitEvent:
+    """
+    The exit event of processes in sessions or agents. It can be waited in a
+    thread, or notify by callbacks, like asyncio futures.
+    """
+
+    def __init__(self) -> None:
+        self._event = Event()
+        self._lock = Lock()
+        self._callbacks: List[Callable[[], None]] = []
+
+    def is_set(self) -> bool:
+        return self._event.is_set()
+
+    def wait(self, timeout: Optional[float] = None) -> bool:
+        return self._event.wait(timeout)
+
+    def set(self) -> None:
+        with self._lock:
+            self._event.set()
+            callbacks = self._callbacks
+            self._callbacks = []
+        for callback in callbacks:
+            callback()
+
+    def add_callback(self, callback: Callable[[], None]) -> None:
+        """
+        The callback is called in the thread, which sets the event. If it's set
+        already, the callback is called at once.
+        """
+        with self._lock:
+            if not self._event.is_set():
+                self._callbacks.append(callback)
+                return
+        callback()
+
+
+@dataclass
+class SessionResult:
+    output: str
+    stderr_output: str
+    return_code: int
+
+
+def is_output_kept(writer: Any) -> bool:
+    """
+    The writer of the streaming mode keeps the output by itself, so processes
+    don't keep another copy in memory.
+    """
+    return bool(getattr(writer, "keeps_output", False))
+
+
+class _FramedStream:
+    """
+    It extracts the output of a command between the begin and end sentinels. A
+    sentinel is followed by a value and a line break, like "<sentinel>:<value>".
+    The output before the begin sentinel is left by previous commands, and it's
+    dropped.
+    """
+
+    def __init__(self, begin: str, end: str, writer: Any) -> None:
+        self._begin = begin
+        self._end = end
+        self._writer = writer
+        self._buffer = ""
+        self._outputs: List[str] = []
+        self._is_output_kept = is_output_kept(writer)
+        self.begin_value: Optional[str] = None
+        self.end_value: Optional[str] = None
+
+    @property
+    def output(self) -> str:
+        return "".join(self._outputs)
+
+    def feed(self, text: str) -> None:
+        self._buffer += text
+        if self.begin_value is None:
+            self.begin_value = self._read_value(self._begin)
+            if self.begin_value is None:
+                if self._begin not in self._buffer:
+                    self._buffer = self._buffer[-len(self._begin) :]
+                return
+        if self.end_value is None:
+            index = self._buffer.find(self._end)
+            if index < 0:
+                # keep a possible partial sentinel at the end.
+                length = max(len(self._buffer) - len(self._end), 0)
+                self._write(self._buffer[:length])
+                self._buffer = self._buffer[length:]
+                return
+            self._write(self._buffer[:index])
+            self._buffer = self._buffer[index:]
+            self.end_value = self._read_value(self._end)
+
+    def _read_value(self, sentinel: str) -> Optional[str]:
+        index = self._buffer.find(sentinel)
+        if index < 0:
+            return None
+        line_end = self._buffer.find("\n", index)
+        if line_end < 0:
+            return None
+        value = self._buffer[index + len(sentinel) + 1 : line_end]
+        self._buffer = self._buffer[line_end + 1 :]
+        return value
+
+    def _write(self, text: str) -> None:
+        if text:
+            if not self._is_output_kept:
+                self._outputs.append(text)
+            if self._writer:
+                self._writer.write(text)
+
+
+class SessionProcess:
+    """
+    A command, which runs in a shell session. It has the same methods as spur
+    processes, which are used by Process.
+    """
+
+    def __init__(
+        self,
+        session: "ShellSession",
+        stdout: Any,
+        stderr: Any,
+        encoding: str,
+    ) -> None:
+        self._session = session
+        self.id_ = uuid.uuid4().hex
+        self.begin_sentinel = f"__lisa_begin_{self.id_}__"
+        self.end_sentinel = f"__lisa_end_{self.id_}__"
+        self._stdout = _FramedStream(self.begin_sentinel, self.end_sentinel, stdout)
+        self._stderr = _FramedStream(self.begin_sentinel, self.end_sentinel, stderr)
+        decoder_type = codecs.getincrementaldecoder(encoding)
+        self._stdout_decoder = decoder_type(errors="replace")
+        self._stderr_decoder = decoder_type(errors="replace")
+        self._exited = ExitEvent()
+        self._return_code = SESSION_CLOSED_EXIT_CODE
+
+    def is_running(self) -> bool:
+        return not self._exited.is_set()
+
+    def wait(self, timeout: Optional[float] = None) -> bool:
+        return self._exited.wait(timeout)
+
+    def add_exit_callback(self, callback: Callable[[], None]) -> None:
+        self._exited.add_callback(callback)
+
+    def wait_for_result(self) -> SessionResult:
+        self._exited.wait()
+        return SessionResult(
+            output=self._stdout.output,
+            stderr_output=self._stderr.output,
+            return_code=self._return_code,
+        )
+
+    def send_signal(self, signal_number: int) -> None:
+        pid = self._stdout.begin_value
+        if pid and self.is_running():
+            self._session.kill(pid, signal_number)
+
+    def feed_stdout(self, data: bytes) -> None:
+        self._stdout.feed(self._stdout_decoder.decode(data))
+        self._check_exited()
+
+    def feed_stderr(self, data: bytes) -> None:
+        self._stderr.feed(self._stderr_decoder.decode(data))
+        self._check_exited()
+
+    def close(self) -> None:
+        self._exited.set()
+
+    def _check_exited(self) -> None:
+        if self._stdout.end_value is not None and self._stderr.end_value is not None:
+            self._return_code = int(self._stdout.end_value)
+            # release the session before notifying waiters, so they can run
+            # next commands in the session.
+            self._session.on_exited(self)
+            self._exited.set()
+
+
+class ShellSession:
+    """
+    It keeps a sh running in a channel, and runs commands in it one by one, so
+    commands don't pay for opening a channel and starting a shell. Each command
+    is framed by sentinels with an unique id in both stdout and stderr. The begin
+    sentinel carries the pid of the command, and the end sentinel carries the
+    exit code.
+
+    Commands run without pty and stdin, so the stdout and stderr are separated.
+    """
+
+    def __init__(self, transport: paramiko.Transport, timeout: float = 10) -> None:
+        self._transport = transport
+        self._timeout = timeout
+        self._channel = transport.open_session(timeout=timeout)
+        self._channel.exec_command("sh")
+        self._lock = Lock()
+        self._current: Optional[SessionProcess] = None
+        self._is_closed = False
+        self._reader = Thread(target=self._read, daemon=True)
+        self._reader.start()
+
+    @property
+    def is_closed(self) -> bool:
+        return self._is_closed
+
+    def try_spawn(
+        self,
+        command: Sequence[str],
+        update_env: Optional[Mapping[str, str]] = None,
+        cwd: Optional[str] = None,
+        stdout: Any = None,
+        stderr: Any = None,
+        encoding: str = "utf-8",
+    ) -> Optional[SessionProcess]:
+        """
+        It returns None, if the session is running another command, so the
+        caller can run it in a new channel.
+        """
+        if not self._lock.acquire(blocking=False):
+            return None
+        try:
+            if self._is_closed:
+                self._lock.release()
+                return None
+            process = SessionProcess(
+                self, stdout=stdout, stderr=stderr, encoding=encoding
+            )
+            self._current = process
+            self._channel.sendall(
+                self._generate_script(process, command, update_env, cwd).encode("utf-8")
+            )
+        except Exception as identifier:
+            self._current = None
+            self._lock.release()
+            self.close()
+            raise LisaException(f"failed to run command in session: {identifier}")
+        return process
+
+    def kill(self, pid: str, signal_number: int) -> None:
+        # the session is busy, so kill it in a new channel. It's the reserved
+        # channel out of the pool.
+        channel = self._transport.open_session(timeout=self._timeout)
+        try:
+            channel.exec_command(f"kill -{int(signal_number)} {pid}")
+            if not channel.status_event.wait(self._timeout):
+                raise LisaException(f"timeout on killing process {pid}")
+        finally:
+            channel.close()
+
+    def close(self) -> None:
+        self._is_closed = True
+        self._channel.close()
+
+    def on_exited(self, process: SessionProcess) -> None:
+        if self._current is process:
+            self._current = None
+            self._lock.release()
+
+    def _generate_script(
+        self,
+        process: SessionProcess,
+        command: Sequence[str],
+        update_env: Optional[Mapping[str, str]],
+        cwd: Optional[str],
+    ) -> str:
+        begin = process.begin_sentinel
+        end = process.end_sentinel
+        # the begin sentinel is printed by the shell, which is replaced by the
+        # command, so the pid is the pid of the command.
+        inner_script = f"printf '%s:%s\\n' {begin} $$; printf '%s:\\n' {begin} >&2; "
+        if cwd:
+            inner_script += f"cd {shlex.quote(cwd)} || exit 1; "
+        inner_script += "exec "
+        if update_env:
+            env_args = [f"{key}={value}" for key, value in update_env.items()]
+            inner_script += f"env {' '.join(shlex.quote(x) for x in env_args)} "
+        inner_script += " ".join(shlex.quote(x) for x in command)
+        return (
+            f"sh -c {shlex.quote(inner_script)} </dev/null; "
+            f"printf '%s:%s\\n' {end} $?; printf '%s:\\n' {end} >&2\n"
+        )
+
+    def _read(self) -> None:
+        channel = self._channel
+        try:
+            while True:
+                # the channel is readable on both stdout and stderr data.
+                select.select([channel], [], [], 1)
+                has_data = False
+                while channel.recv_ready():
+                    has_data = True
+                    self._dispatch(channel.recv(65536), is_stdout=True)
+                while channel.recv_stderr_ready():
+                    has_data = True
+                    self._dispatch(channel.recv_stderr(65536), is_stdout=False)
+                if not has_data and (channel.closed or channel.exit_status_ready()):
+                    break
+        finally:
+            self._is_closed = True
+            current = self._current
+            if current:
+                current.close()
+
+    def _dispatch(self, data: bytes, is_stdout: bool) -> None:
+        current = self._current
+        if current is None:
+            return
+        if is_stdout:
+            current.feed_stdout(data)
+        else:
+            current.feed_stderr(data)
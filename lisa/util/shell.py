@@ -1,60 +1,184 @@
 # Copyright (c) Microsoft Corporation.
 # Licensed under the MIT license.
 
+import asyncio
+import io
 import logging
 import os
+import shlex
 import shutil
 import socket
+import stat as statlib
 import sys
-from pathlib import Path, PurePath
-from time import sleep
-from typing import Any, Dict, List, Mapping, Optional, Sequence, Tuple, Union, cast
+import tarfile
+from collections import deque
+from functools import partial
+from pathlib import Path, PurePath, PurePosixPath
+from threading import Event, Lock, local
+from typing import (
+    Any,
+    Callable,
+    Deque,
+    Dict,
+    List,
+    Mapping,
+    Optional,
+    Sequence,
+    Tuple,
+    Type,
+    Union,
+    cast,
+)
 
 import paramiko
 import spur  # type: ignore
 import spurplus  # type: ignore
-from func_timeout import FunctionTimedOut, func_set_timeout  # type: ignore
 from paramiko.ssh_exception import SSHException
 from retry import retry
 
-from lisa.util import InitializableMixin, LisaException
+from lisa.util import InitializableMixin, LisaException, constants
 
+from .agent import AGENT_SCRIPT_PATH, AgentClient, AgentProcess
+from .channel_process import ChannelProcess, generate_run_command
+from .local_process import LocalStreamProcess
 from .logger import Logger
-from .perf_timer import create_timer
+from .prober import get_tcp_port_prober
+from .session import SessionProcess, ShellSession, is_output_kept
+from .transfer import download_by_tar, upload_by_tar
 
 
 def wait_tcp_port_ready(
     address: str, port: int, log: Optional[Logger] = None, timeout: int = 300
 ) -> Tuple[bool, int]:
     """
-    return is ready or not
+    return is ready or not. Ports of all nodes are checked together in the shared
+    prober, and it returns once the port is opened.
     """
-    is_ready: bool = False
-    # TODO: may need to support IPv6.
-    times: int = 0
-    result: int = 0
-
-    timout_timer = create_timer()
-    while timout_timer.elapsed(False) < timeout:
-        with socket.socket(socket.AF_INET, socket.SOCK_STREAM) as tcp_socket:
-            try:
-                result = tcp_socket.connect_ex((address, port))
-                if result == 0:
-                    is_ready = True
-                    break
-                else:
-                    if times % 10 == 0 and log:
-                        log.debug(
-                            f"cannot connect to {address}:{port}, "
-                            f"error code: {result}, current try: {times + 1},"
-                            f" elapsed: {timout_timer.elapsed(False)} "
-                            f"(timeout on {timeout}). retrying..."
-                        )
-                    sleep(1)
-                    times += 1
-            except Exception as e:
-                raise LisaException(f"failed to connect to {address}:{port}: {e}")
-    return is_ready, result
+    return get_tcp_port_prober().wait(address, port, timeout=timeout, log=log)
+
+
+# the time to wait for connecting, opening a channel, or a dead connection.
+SPAWN_TIMEOUT = 20
+
+# sshd allows 10 sessions per connection by default. Sftp clients of spur and the
+# paramiko backend use one each, and one is reserved for control operations out
+# of the pool, like killing commands. So they don't wait for busy channels.
+DEFAULT_MAX_CHANNELS = 7
+
+# the time to wait for a free channel, before failing the command.
+CHANNEL_WAIT_TIMEOUT = 300
+
+
+class ChannelBusyError(LisaException):
+    pass
+
+
+class _LoopWaiter:
+    """
+    A waiter of a coroutine. The channel is handed over by completing the future
+    in its loop, so the loop isn't blocked on waiting.
+    """
+
+    def __init__(self, loop: asyncio.AbstractEventLoop) -> None:
+        self._loop = loop
+        self._is_set = False
+        self.future: "asyncio.Future[None]" = loop.create_future()
+
+    def set(self) -> None:
+        self._is_set = True
+        self._loop.call_soon_threadsafe(_set_future_done, self.future)
+
+    def is_set(self) -> bool:
+        return self._is_set
+
+
+def _set_future_done(future: "asyncio.Future[None]") -> None:
+    if not future.done():
+        future.set_result(None)
+
+
+class ChannelPool:
+    """
+    It limits concurrent channels on one SSH transport. If there is no free
+    channel, callers wait in the FIFO order, so a busy thread cannot starve
+    others. Threads and coroutines wait in the same order.
+    """
+
+    def __init__(self, max_channels: int) -> None:
+        assert max_channels > 0, f"max_channels must be positive: {max_channels}"
+        self._lock = Lock()
+        self._available = max_channels
+        self._waiters: Deque[Union[Event, _LoopWaiter]] = deque()
+        self._is_closed = False
+
+    def acquire(self, timeout: float = CHANNEL_WAIT_TIMEOUT) -> None:
+        with self._lock:
+            if self._try_acquire():
+                return
+            waiter = Event()
+            self._waiters.append(waiter)
+        # the released channel is handed over to the first waiter directly.
+        waiter.wait(timeout)
+        self._check_waiter(waiter, timeout)
+
+    async def acquire_async(self, timeout: float = CHANNEL_WAIT_TIMEOUT) -> None:
+        with self._lock:
+            if self._try_acquire():
+                return
+            waiter = _LoopWaiter(asyncio.get_running_loop())
+            self._waiters.append(waiter)
+        try:
+            await asyncio.wait_for(asyncio.shield(waiter.future), timeout)
+        except asyncio.TimeoutError:
+            pass
+        except BaseException as identifier:
+            # it's cancelled, so the channel is given back, if it's handed over.
+            with self._lock:
+                is_handed_over = waiter.is_set()
+                if not is_handed_over:
+                    self._waiters.remove(waiter)
+            if is_handed_over and not self._is_closed:
+                self.release()
+            raise identifier
+        self._check_waiter(waiter, timeout)
+
+    def release(self) -> None:
+        with self._lock:
+            if self._waiters:
+                self._waiters.popleft().set()
+            else:
+                self._available += 1
+
+    def close(self) -> None:
+        """
+        The transport is closed, so waiters fail, instead of waiting for
+        channels, which are never released.
+        """
+        with self._lock:
+            self._is_closed = True
+            while self._waiters:
+                self._waiters.popleft().set()
+
+    def _try_acquire(self) -> bool:
+        self._check_closed()
+        if self._available > 0 and not self._waiters:
+            self._available -= 1
+            return True
+        return False
+
+    def _check_waiter(self, waiter: Union[Event, _LoopWaiter], timeout: float) -> None:
+        with self._lock:
+            if not waiter.is_set():
+                self._waiters.remove(waiter)
+                raise ChannelBusyError(
+                    f"no free channel in {timeout} seconds. Commands may be not "
+                    f"waited, or too many commands run at the same time."
+                )
+            self._check_closed()
+
+    def _check_closed(self) -> None:
+        if self._is_closed:
+            raise LisaException("the connection is closed, no channel to use.")
 
 
 class ConnectionInfo:
@@ -65,12 +189,20 @@ class ConnectionInfo:
         username: str = "root",
         password: Optional[str] = "",
         private_key_file: Optional[str] = None,
+        max_channels: int = DEFAULT_MAX_CHANNELS,
+        use_session: bool = False,
+        use_agent: bool = False,
+        shell_backend: str = constants.SHELL_BACKEND_SPUR,
     ) -> None:
         self.address = address
         self.port = port
         self.username = username
         self.password = password
         self.private_key_file = private_key_file
+        self.max_channels = max_channels
+        self.use_session = use_session
+        self.use_agent = use_agent
+        self.shell_backend = shell_backend
 
         if not self.password and not self.private_key_file:
             raise LisaException(
@@ -139,48 +271,177 @@ class WindowsShellType(object):
 
 # retry strategy is the same as spurplus.connect_with_retries.
 @retry(Exception, tries=3, delay=1, logger=None)
-def try_connect(connection_info: ConnectionInfo) -> Any:
-    # spur always run a posix command and will fail on Windows.
-    # So try with paramiko firstly.
-    paramiko_client = paramiko.SSHClient()
-    paramiko_client.set_missing_host_key_policy(paramiko.AutoAddPolicy())
-
-    paramiko_client.connect(
-        hostname=connection_info.address,
-        port=connection_info.port,
-        username=connection_info.username,
-        password=connection_info.password,
-        key_filename=connection_info.private_key_file,
-        banner_timeout=10,
-    )
-    stdin, stdout, _ = paramiko_client.exec_command("cmd\n")
-    # Flush commands and prevent more writes
-    stdin.flush()
-
-    # Give it some time to process the command, otherwise reads on
-    # stdout on calling contexts have been seen having empty strings
-    # from stdout, on Windows. There is a certain 3s penalty on Linux
-    # systems, as it's never ready for that (inexisting) command, but
-    # that should only happen once per node (not per command)
-    tries = 3
-    while not stdout.channel.recv_ready() and tries:
-        sleep(1)
-        tries -= 1
-
-    stdin.channel.shutdown_write()
-    paramiko_client.close()
-
-    return stdout
-
-
-# paramiko stuck on get command output of 'fortinet' VM, and spur hide timeout of
-# exec_command. So use an external timeout wrapper to force timeout.
-# some images needs longer time to set up ssh connection.
-# e.g. Oracle Oracle-Linux 7.5 7.5.20181207
-# e.g. qubole-inc qubole-data-service default-img 0.7.4
-@func_set_timeout(20)  # type: ignore
-def _spawn_ssh_process(shell: spur.ssh.SshShell, **kwargs: Any) -> spur.ssh.SshProcess:
-    return shell.spawn(**kwargs)
+def try_connect(spur_ssh_shell: spur.SshShell) -> paramiko.Transport:
+    # spur connects the transport lazily without a lock, so connect it here
+    # before concurrent commands use it.
+    return spur_ssh_shell._get_ssh_transport()
+
+
+def _detect_is_posix(transport: paramiko.Transport, timeout: float = 10) -> bool:
+    # spur always run a posix command and will fail on Windows. So detect the
+    # shell by paramiko on the connected transport. The "ver" command prints
+    # the version on Windows, and it's not found and exits at once on posix.
+    channel = transport.open_session(timeout=timeout)
+    output = b""
+    try:
+        channel.settimeout(timeout)
+        channel.exec_command("ver")
+        # Some windows doesn't end the text stream, so stop once it's detected.
+        while b"Windows" not in output:
+            data = channel.recv(1024)
+            if not data:
+                break
+            output += data
+    except socket.timeout:
+        pass
+    finally:
+        channel.close()
+    return b"Windows" not in output
+
+
+def is_in_event_loop() -> bool:
+    try:
+        asyncio.get_running_loop()
+    except RuntimeError:
+        return False
+    return True
+
+
+def _is_channel_closed(process: Any) -> bool:
+    # the channel is closed by paramiko, when the command exits on the node.
+    channel = getattr(process, "_channel", None)
+    return channel is not None and bool(channel.closed)
+
+
+def _set_timeouts(transport: paramiko.Transport, timeout: float) -> None:
+    # opening a channel fails, if the node doesn't respond in the timeout.
+    transport.channel_timeout = timeout
+    # keepalive packets are sent on an idle connection. On Linux, the socket is
+    # reset by TCP_USER_TIMEOUT, if they aren't acknowledged in the timeout. So
+    # reads on channels return, instead of hanging on a dead connection, like a
+    # rebooted node. Other systems don't support it, so starting commands is
+    # limited by _SpawnTransport, and waiting is limited by timeouts of commands.
+    transport.set_keepalive(max(int(timeout / 4), 1))
+    tcp_user_timeout = getattr(socket, "TCP_USER_TIMEOUT", None)
+    if tcp_user_timeout and isinstance(transport.sock, socket.socket):
+        transport.sock.setsockopt(
+            socket.IPPROTO_TCP, tcp_user_timeout, int(timeout * 1000)
+        )
+
+
+def _probe_shell(transport: paramiko.Transport, command: str, timeout: float) -> bool:
+    """
+    spur reads the pid and the exit code of "which" from the output, before a
+    command starts. paramiko stuck on it in the shell of 'fortinet' VM, so check
+    the shell on the channel with a timeout, before spur uses it.
+    """
+    channel = transport.open_session(timeout=timeout)
+    output = b""
+    try:
+        channel.settimeout(timeout)
+        channel.exec_command(command)
+        while True:
+            data = channel.recv(1024)
+            if not data:
+                break
+            output += data
+    except socket.timeout:
+        return False
+    finally:
+        channel.close()
+    numbers = [x for x in output.decode("utf-8", "replace").split() if x.isdigit()]
+    return len(numbers) >= 2
+
+
+class _SpawnChannel:
+    """
+    A channel of a spawn. Reads on it time out, until the spawn returns, so a
+    blocked read of the pid raises socket.timeout. After that, reads block as
+    usual, including reads, which are started in the spawn by output threads of
+    spur.
+    """
+
+    def __init__(self, channel: paramiko.Channel, timeout: float) -> None:
+        self._channel = channel
+        self._is_spawning = True
+        self.is_expired = False
+        channel.settimeout(timeout)
+
+    def __getattr__(self, name: str) -> Any:
+        return getattr(self._channel, name)
+
+    def recv(self, nbytes: int) -> bytes:
+        return self._recv(self._channel.recv, nbytes)
+
+    def recv_stderr(self, nbytes: int) -> bytes:
+        return self._recv(self._channel.recv_stderr, nbytes)
+
+    def makefile(self, *args: Any) -> paramiko.ChannelFile:
+        # files read by this wrapper, so their reads are retried after the spawn.
+        return paramiko.ChannelFile(self, *args)
+
+    def makefile_stderr(self, *args: Any) -> paramiko.ChannelFile:
+        return paramiko.channel.ChannelStderrFile(self, *args)
+
+    def finish(self) -> None:
+        self._is_spawning = False
+        self._channel.settimeout(None)
+
+    def _recv(self, read: Callable[[int], bytes], nbytes: int) -> bytes:
+        while True:
+            try:
+                return read(nbytes)
+            except socket.timeout:
+                if self._is_spawning:
+                    self.is_expired = True
+                    raise
+
+
+class _SpawnTransport:
+    """
+    spur reads the pid and the exit code of "which" from a new channel, before a
+    command starts, and the read has no timeout. A shell like fortinet doesn't
+    print them, and keepalive packets are still acknowledged, so the spawn hangs.
+    spur opens channels by this wrapper of the transport, so reads of a spawn
+    time out on channels, without a thread to watch the deadline.
+    """
+
+    def __init__(self, transport: paramiko.Transport) -> None:
+        self._transport = transport
+        self._local = local()
+
+    def __getattr__(self, name: str) -> Any:
+        return getattr(self._transport, name)
+
+    def open_session(self, *args: Any, **kwargs: Any) -> Any:
+        channel = self._transport.open_session(*args, **kwargs)
+        timeout: Optional[float] = getattr(self._local, "timeout", None)
+        if timeout is None:
+            return channel
+        spawn_channel = _SpawnChannel(channel, timeout)
+        self._local.channels.append(spawn_channel)
+        return spawn_channel
+
+    def spawn(self, spawn: Callable[[], Any], timeout: float, command: Any) -> Any:
+        channels: List[_SpawnChannel] = []
+        self._local.timeout = timeout
+        self._local.channels = channels
+        try:
+            return spawn()
+        except Exception as identifier:
+            if any(x.is_expired for x in channels):
+                for channel in channels:
+                    channel.close()
+                raise LisaException(
+                    f"timeout in {timeout} seconds on starting {command}. The "
+                    f"shell of the node doesn't respond."
+                )
+            raise identifier
+        finally:
+            self._local.timeout = None
+            self._local.channels = None
+            for channel in channels:
+                channel.finish()
 
 
 class SshShell(InitializableMixin):
@@ -190,6 +451,28 @@ class SshShell(InitializableMixin):
         self._connection_info = connection_info
         self._inner_shell: Optional[spur.SshShell] = None
         self._is_connected: bool = False
+        self._is_posix: Optional[bool] = None
+        self._transport: Optional[paramiko.Transport] = None
+        self._spawn_transport: Optional[_SpawnTransport] = None
+        # commands run in a long-lived shell, if it's not busy. It can be changed
+        # at runtime, like comparing performance of both ways.
+        self.use_session = connection_info.use_session
+        self._session: Optional[ShellSession] = None
+        self._session_lock = Lock()
+        # commands run by the agent, after it's started by the node. It can be
+        # changed at runtime like use_session.
+        self.use_agent = connection_info.use_agent
+        self._agent: Optional[AgentClient] = None
+        self._agent_path: Optional[PurePath] = None
+        # commands run in channels of one transport, so they don't repeat the
+        # SSH handshake.
+        self._channel_pool = ChannelPool(connection_info.max_channels)
+        # processes and the pools, which their channels are acquired from. So a
+        # channel is released once, and to the pool of its connection.
+        self._channel_owners: Dict[Any, ChannelPool] = {}
+        self._channel_lock = Lock()
+        # the channel, which is acquired by spawn_async for the spawning thread.
+        self._reserved_channel = local()
 
         paramiko_logger = logging.getLogger("paramiko")
         paramiko_logger.setLevel(logging.WARN)
@@ -204,27 +487,6 @@ class SshShell(InitializableMixin):
                 f"[{self._connection_info.address}:{self._connection_info.port}], "
                 f"error code: {tcp_error_code}"
             )
-        try:
-            stdout = try_connect(self._connection_info)
-        except Exception as identifier:
-            raise LisaException(
-                f"failed to connect SSH "
-                f"[{self._connection_info.address}:{self._connection_info.port}], "
-                f"{identifier.__class__.__name__}: {identifier}"
-            )
-
-        # Some windows doesn't end the text stream, so read first line only.
-        # it's  enough to detect os.
-        stdout_content = stdout.readline()
-        stdout.close()
-
-        if stdout_content and "Windows" in stdout_content:
-            self.is_posix = False
-            shell_type = WindowsShellType()
-        else:
-            self.is_posix = True
-            shell_type = spur.ssh.ShellTypes.sh
-
         spur_kwargs = {
             "hostname": self._connection_info.address,
             "port": self._connection_info.port,
@@ -233,18 +495,70 @@ class SshShell(InitializableMixin):
             "private_key_file": self._connection_info.private_key_file,
             "missing_host_key": spur.ssh.MissingHostKey.accept,
         }
+        spur_ssh_shell = spur.SshShell(
+            shell_type=self._get_shell_type(),
+            # some images needs longer time to set up ssh connection.
+            # e.g. Oracle Oracle-Linux 7.5 7.5.20181207
+            # e.g. qubole-inc qubole-data-service default-img 0.7.4
+            connect_timeout=SPAWN_TIMEOUT,
+            **spur_kwargs,
+        )
+        try:
+            transport = try_connect(spur_ssh_shell)
+            _set_timeouts(transport, SPAWN_TIMEOUT)
+            # the shell type of a node doesn't change, so it's detected on the
+            # first connection only.
+            if self._is_posix is None:
+                is_posix = _detect_is_posix(transport)
+                if is_posix:
+                    probe_command = spur.ssh.ShellTypes.sh.generate_run_command(
+                        ["true"], store_pid=True
+                    )
+                    if not _probe_shell(transport, probe_command, SPAWN_TIMEOUT):
+                        raise LisaException(
+                            "The remote node is timeout on running command. It may "
+                            "be caused by paramiko/spur not support the shell of node."
+                        )
+                self._is_posix = is_posix
+                spur_ssh_shell._shell_type = self._get_shell_type()
+        except Exception as identifier:
+            raise LisaException(
+                f"failed to connect SSH "
+                f"[{self._connection_info.address}:{self._connection_info.port}], "
+                f"{identifier.__class__.__name__}: {identifier}"
+            )
+        self.is_posix = self._is_posix
 
-        spur_ssh_shell = spur.SshShell(shell_type=shell_type, **spur_kwargs)
+        self._transport = transport
+        # the transport is connected, so spur gets the wrapper from now on.
+        spawn_transport = _SpawnTransport(transport)
+        spur_ssh_shell._get_ssh_transport = lambda: spawn_transport
+        self._spawn_transport = spawn_transport
         sftp = spurplus.sftp.ReconnectingSFTP(
             sftp_opener=spur_ssh_shell._open_sftp_client
         )
         self._inner_shell = spurplus.SshShell(spur_ssh_shell=spur_ssh_shell, sftp=sftp)
 
+    def _get_shell_type(self) -> Any:
+        if self._is_posix is False:
+            return WindowsShellType()
+        return spur.ssh.ShellTypes.sh
+
     def close(self) -> None:
+        self._close_session()
+        self._close_agent()
         if self._inner_shell:
             self._inner_shell.close()
             # after closed, can be reconnect
             self._inner_shell = None
+        self._transport = None
+        self._spawn_transport = None
+        # channels of the closed transport are gone, so the next connection
+        # starts with a new pool, even if some processes aren't waited.
+        with self._channel_lock:
+            self._channel_pool.close()
+            self._channel_pool = ChannelPool(self._connection_info.max_channels)
+            self._channel_owners.clear()
         self._is_initialized = False
 
     @property
@@ -265,13 +579,37 @@ class SshShell(InitializableMixin):
         encoding: str = "utf-8",
         use_pty: bool = True,
         allow_error: bool = True,
-    ) -> spur.ssh.SshProcess:
+    ) -> Union[spur.ssh.SshProcess, SessionProcess, AgentProcess, ChannelProcess]:
         self.initialize()
-        assert self._inner_shell
 
+        agent = self._get_agent()
+        if agent:
+            return agent.spawn(
+                command=command,
+                update_env=update_env,
+                cwd=str(cwd) if cwd else None,
+                stdout=stdout,
+                stderr=stderr,
+                encoding=encoding,
+                use_pty=use_pty,
+            )
+
+        if self.use_session and self.is_posix:
+            session_process = self._spawn_in_session(
+                command=command,
+                update_env=update_env,
+                cwd=str(cwd) if cwd else None,
+                stdout=stdout,
+                stderr=stderr,
+                encoding=encoding,
+            )
+            if session_process:
+                return session_process
+
+        # the channel is released by release_channel, after the process exits.
+        pool = self._acquire_channel()
         try:
-            process: spur.ssh.SshProcess = _spawn_ssh_process(
-                self._inner_shell,
+            process = self._spawn_in_channel(
                 command=command,
                 update_env=update_env,
                 store_pid=store_pid,
@@ -282,13 +620,218 @@ class SshShell(InitializableMixin):
                 use_pty=use_pty,
                 allow_error=allow_error,
             )
-        except FunctionTimedOut:
+        except paramiko.SSHException as identifier:
+            pool.release()
             raise LisaException(
-                f"The remote node is timeout on execute {command}. "
-                f"It may be caused by paramiko/spur not support the shell of node."
+                f"The remote node failed on execute {command}: {identifier}"
             )
+        except Exception as identifier:
+            pool.release()
+            raise identifier
+        with self._channel_lock:
+            self._channel_owners[process] = pool
         return process
 
+    def _spawn_in_channel(
+        self, **kwargs: Any
+    ) -> Union[spur.ssh.SshProcess, ChannelProcess]:
+        if is_output_kept(kwargs.get("stdout")) and self.is_posix:
+            # spur keeps a copy of the whole output, so streaming commands run
+            # in paramiko channels directly, and the memory is bounded.
+            return self._spawn_channel_process(**kwargs)
+        assert self._inner_shell
+        assert self._spawn_transport
+        inner_shell = self._inner_shell
+        return self._spawn_transport.spawn(
+            lambda: inner_shell.spawn(**kwargs), SPAWN_TIMEOUT, kwargs["command"]
+        )
+
+    def _spawn_channel_process(self, **kwargs: Any) -> ChannelProcess:
+        assert self._transport
+        cwd = kwargs["cwd"]
+        channel = self._transport.open_session()
+        try:
+            if kwargs["use_pty"]:
+                channel.get_pty()
+            channel.exec_command(
+                generate_run_command(
+                    kwargs["command"], kwargs["update_env"], str(cwd) if cwd else None
+                )
+            )
+        except Exception as identifier:
+            channel.close()
+            raise identifier
+        return ChannelProcess(
+            channel,
+            kill=self._kill,
+            stdout=kwargs["stdout"],
+            stderr=kwargs["stderr"],
+            encoding=kwargs["encoding"],
+        )
+
+    def _kill(self, pid: str, signal_number: int) -> None:
+        assert self._transport
+        # it runs out of the pool, since the pool may be full of busy commands.
+        channel = self._transport.open_session(timeout=SPAWN_TIMEOUT)
+        try:
+            channel.exec_command(f"kill -{int(signal_number)} {int(pid)}")
+            if not channel.status_event.wait(SPAWN_TIMEOUT):
+                raise LisaException(f"timeout on killing process {pid}")
+        finally:
+            channel.close()
+
+    def release_channel(self, process: Any) -> None:
+        """
+        It's called after the process exits, and it can be called more than once.
+        """
+        with self._channel_lock:
+            pool = self._channel_owners.pop(process, None)
+        if pool:
+            pool.release()
+
+    async def spawn_async(
+        self, **kwargs: Any
+    ) -> Union[spur.ssh.SshProcess, SessionProcess, AgentProcess, ChannelProcess]:
+        """
+        The coroutine version of spawn. A free channel is waited in the loop, so
+        commands queue up, instead of failing or taking threads to wait. Then it's
+        spawned in a thread of the loop executor, since connecting and opening
+        the channel block.
+        """
+        self._release_exited_channels()
+        pool = self._channel_pool
+        await pool.acquire_async()
+        loop = asyncio.get_running_loop()
+        return await loop.run_in_executor(
+            None, partial(self._spawn_with_channel, pool, kwargs)
+        )
+
+    def _spawn_with_channel(self, pool: ChannelPool, kwargs: Dict[str, Any]) -> Any:
+        self._reserved_channel.pool = pool
+        try:
+            return self.spawn(**kwargs)
+        finally:
+            # the agent or the session doesn't use the channel.
+            if self._reserved_channel.pool:
+                self._reserved_channel.pool = None
+                pool.release()
+
+    def _acquire_channel(self) -> ChannelPool:
+        reserved_pool: Optional[ChannelPool] = getattr(
+            self._reserved_channel, "pool", None
+        )
+        if reserved_pool:
+            self._reserved_channel.pool = None
+            return reserved_pool
+        self._release_exited_channels()
+        pool = self._channel_pool
+        timeout: float = CHANNEL_WAIT_TIMEOUT
+        if is_in_event_loop():
+            # channels are released by coroutines in the loop, so waiting for
+            # them blocks the loop forever. It fails instead, and coroutines wait
+            # by spawn_async.
+            timeout = 0
+        pool.acquire(timeout)
+        return pool
+
+    def _release_exited_channels(self) -> None:
+        # channels of exited processes are released, even if they aren't waited.
+        with self._channel_lock:
+            exited = [x for x in self._channel_owners if _is_channel_closed(x)]
+        for process in exited:
+            self.release_channel(process)
+
+    def _spawn_in_session(self, **kwargs: Any) -> Optional[SessionProcess]:
+        with self._session_lock:
+            if self._session and self._session.is_closed:
+                self._close_session()
+            if not self._session:
+                assert self._transport
+                # the session holds a channel until it's closed.
+                self._acquire_channel()
+                try:
+                    self._session = ShellSession(self._transport)
+                except Exception as identifier:
+                    self._channel_pool.release()
+                    raise LisaException(f"failed to start shell session: {identifier}")
+            session = self._session
+        return session.try_spawn(**kwargs)
+
+    def start_agent(self, node_path: PurePath) -> None:
+        """
+        Copy the agent to the folder on the node, and start it. Then commands,
+        file reads and stat calls are served by the agent in one channel. If the
+        connection is reset, the agent is started again on next connecting.
+        """
+        self.initialize()
+        if not self.is_posix:
+            raise LisaException("agent is supported on posix nodes only")
+        agent_path = node_path / AGENT_SCRIPT_PATH.name
+        self.copy(AGENT_SCRIPT_PATH, agent_path)
+        self._agent_path = agent_path
+        self.use_agent = True
+        with self._session_lock:
+            self._start_agent()
+
+    def read_bytes(self, path: PurePath) -> bytes:
+        self.initialize()
+        assert self._inner_shell
+        path_str = self._purepath_to_str(path)
+        agent = self._get_agent()
+        if agent:
+            return agent.read_bytes(str(path))
+        return cast(bytes, self._inner_shell.read_bytes(path_str))
+
+    def _get_agent(self) -> Optional[AgentClient]:
+        if not self.use_agent or not self._agent_path:
+            return None
+        with self._session_lock:
+            if self._agent and self._agent.is_closed:
+                # the agent is closed with the connection, like rebooting.
+                self._close_agent()
+            if not self._agent:
+                try:
+                    self._start_agent()
+                except LisaException:
+                    # commands run in channels, if the agent cannot be started.
+                    return None
+            return self._agent
+
+    def _start_agent(self) -> None:
+        assert self._transport
+        assert self._agent_path
+        # the agent holds a channel until it's closed.
+        self._acquire_channel()
+        command = f"python3 {shlex.quote(str(self._agent_path))}"
+        try:
+            self._agent = AgentClient(self._transport, command)
+        except Exception as identifier:
+            self._channel_pool.release()
+            # don't try again.
+            self._agent_path = None
+            raise LisaException(f"failed to start agent: {identifier}")
+
+    def stop_agent(self) -> None:
+        """
+        Close the agent, and run commands in channels again.
+        """
+        self.use_agent = False
+        self._agent_path = None
+        with self._session_lock:
+            self._close_agent()
+
+    def _close_agent(self) -> None:
+        if self._agent:
+            self._agent.close()
+            self._agent = None
+            self._channel_pool.release()
+
+    def _close_session(self) -> None:
+        if self._session:
+            self._session.close()
+            self._session = None
+            self._channel_pool.release()
+
     def mkdir(
         self,
         path: PurePath,
@@ -307,7 +850,18 @@ class SshShell(InitializableMixin):
             # no sftp, try commands
             if "Channel closed." in str(identifier):
                 assert isinstance(path_str, str)
-                self.spawn(command=["mkdir", "-p", path_str])
+                process = self.spawn(command=["mkdir", "-p", path_str])
+                try:
+                    result = process.wait_for_result()
+                finally:
+                    self.release_channel(process)
+                if result.return_code != 0:
+                    raise LisaException(
+                        f"failed to create folder '{path_str}' by command: "
+                        f"{result.output}{result.stderr_output}"
+                    )
+            else:
+                raise identifier
 
     def exists(self, path: PurePath) -> bool:
         self.initialize()
@@ -331,6 +885,9 @@ class SshShell(InitializableMixin):
         self.initialize()
         assert self._inner_shell
         path_str = self._purepath_to_str(path)
+        agent = self._get_agent()
+        if agent:
+            return agent.stat(str(path))
         sftp_attributes: paramiko.SFTPAttributes = self._inner_shell.stat(path_str)
 
         result = os.stat_result(())
@@ -392,6 +949,49 @@ class SshShell(InitializableMixin):
             consistent=self.is_posix,
         )
 
+    def copy_back(
+        self, node_path: PurePath, local_path: PurePath, log: Optional[Logger] = None
+    ) -> None:
+        """
+        Download a file or a folder from the node to the local path.
+        """
+        self.initialize()
+        assert self._inner_shell
+        local_path = Path(local_path)
+        if self.is_posix:
+            assert self._transport
+            pool = self._acquire_channel()
+            try:
+                download_by_tar(
+                    self._transport, PurePosixPath(node_path), local_path, log=log
+                )
+            finally:
+                pool.release()
+        else:
+            # tar may not exist on Windows, so files are downloaded by sftp.
+            self._inner_shell.get(
+                self._purepath_to_str(node_path),
+                str(local_path),
+                create_directories=True,
+                consistent=False,
+            )
+
+    def upload_archive(
+        self, archive: bytes, node_path: PurePath, log: Optional[Logger] = None
+    ) -> None:
+        """
+        Extract a tar.gz archive to the folder on the node.
+        """
+        self.initialize()
+        if not self.is_posix:
+            raise LisaException("uploading archive is supported on posix nodes only")
+        assert self._transport
+        pool = self._acquire_channel()
+        try:
+            upload_by_tar(self._transport, archive, PurePosixPath(node_path), log=log)
+        finally:
+            pool.release()
+
     def _purepath_to_str(
         self, path: Union[Path, PurePath, str]
     ) -> Union[Path, PurePath, str]:
@@ -403,6 +1003,158 @@ class SshShell(InitializableMixin):
         return path
 
 
+class ParamikoShell(SshShell):
+    """
+    It starts commands in paramiko channels directly, without threads and
+    wrappers of spur for each command. File operations share one sftp session
+    of the connection. It works on posix nodes, and Windows nodes fall back to
+    spur. Not found commands return exit code 127, instead of raising an error.
+    """
+
+    def __init__(self, connection_info: ConnectionInfo) -> None:
+        super().__init__(connection_info)
+        self._sftp: Optional[paramiko.SFTPClient] = None
+        self._sftp_lock = Lock()
+
+    def close(self) -> None:
+        if self._sftp:
+            self._sftp.close()
+            self._sftp = None
+        super().close()
+
+    def mkdir(
+        self,
+        path: PurePath,
+        mode: int = 0o777,
+        parents: bool = True,
+        exist_ok: bool = False,
+    ) -> None:
+        sftp = self._get_sftp()
+        if not sftp:
+            return super().mkdir(path, mode=mode, parents=parents, exist_ok=exist_ok)
+        path = PurePosixPath(path)
+        if parents:
+            for parent in reversed(path.parents):
+                if not self.exists(parent):
+                    sftp.mkdir(str(parent), mode)
+        try:
+            sftp.mkdir(str(path), mode)
+        except OSError:
+            if not exist_ok or not self.is_dir(path):
+                raise
+
+    def exists(self, path: PurePath) -> bool:
+        sftp = self._get_sftp()
+        if not sftp:
+            return super().exists(path)
+        try:
+            sftp.stat(str(path))
+        except FileNotFoundError:
+            return False
+        return True
+
+    def remove(self, path: PurePath, recursive: bool = False) -> None:
+        sftp = self._get_sftp()
+        if not sftp:
+            return super().remove(path, recursive)
+        path_str = str(path)
+        if statlib.S_ISDIR(sftp.lstat(path_str).st_mode or 0):
+            if recursive:
+                for entry in sftp.listdir_attr(path_str):
+                    self.remove(PurePosixPath(path_str, entry.filename), recursive)
+            sftp.rmdir(path_str)
+        else:
+            sftp.remove(path_str)
+
+    def chmod(self, path: PurePath, mode: int) -> None:
+        sftp = self._get_sftp()
+        if not sftp:
+            return super().chmod(path, mode)
+        sftp.chmod(str(path), mode)
+
+    def stat(self, path: PurePath) -> os.stat_result:
+        self.initialize()
+        sftp = None if self._get_agent() else self._get_sftp()
+        if not sftp:
+            return super().stat(path)
+        attributes = sftp.stat(str(path))
+        mtime = attributes.st_mtime or 0
+        return os.stat_result(
+            (
+                attributes.st_mode or 0,
+                0,
+                0,
+                0,
+                attributes.st_uid or 0,
+                attributes.st_gid or 0,
+                attributes.st_size or 0,
+                attributes.st_atime or 0,
+                mtime,
+                mtime,
+            )
+        )
+
+    def is_dir(self, path: PurePath) -> bool:
+        sftp = self._get_sftp()
+        if not sftp:
+            return super().is_dir(path)
+        return statlib.S_ISDIR(sftp.stat(str(path)).st_mode or 0)
+
+    def is_symlink(self, path: PurePath) -> bool:
+        sftp = self._get_sftp()
+        if not sftp:
+            return super().is_symlink(path)
+        return statlib.S_ISLNK(sftp.lstat(str(path)).st_mode or 0)
+
+    def symlink(self, source: PurePath, destination: PurePath) -> None:
+        sftp = self._get_sftp()
+        if not sftp:
+            return super().symlink(source, destination)
+        sftp.symlink(str(source), str(destination))
+
+    def chown(self, path: PurePath, uid: int, gid: int) -> None:
+        sftp = self._get_sftp()
+        if not sftp:
+            return super().chown(path, uid, gid)
+        sftp.chown(str(path), uid, gid)
+
+    def copy(self, local_path: PurePath, node_path: PurePath) -> None:
+        sftp = self._get_sftp()
+        if not sftp:
+            return super().copy(local_path, node_path)
+        self.mkdir(node_path.parent, parents=True, exist_ok=True)
+        sftp.put(str(local_path), str(node_path))
+
+    def read_bytes(self, path: PurePath) -> bytes:
+        self.initialize()
+        sftp = None if self._get_agent() else self._get_sftp()
+        if not sftp:
+            return super().read_bytes(path)
+        with sftp.open(str(path), "rb") as file:
+            return cast(bytes, file.read())
+
+    def _spawn_in_channel(
+        self, **kwargs: Any
+    ) -> Union[spur.ssh.SshProcess, ChannelProcess]:
+        if not self.is_posix:
+            return super()._spawn_in_channel(**kwargs)
+        return self._spawn_channel_process(**kwargs)
+
+    def _get_sftp(self) -> Optional[paramiko.SFTPClient]:
+        """
+        return None on Windows nodes, so the spur implementation is used.
+        """
+        self.initialize()
+        if not self.is_posix:
+            return None
+        with self._sftp_lock:
+            if self._sftp is None or self._sftp.get_channel().closed:
+                assert self._transport
+                self._sftp = paramiko.SFTPClient.from_transport(self._transport)
+            assert self._sftp
+            return self._sftp
+
+
 class LocalShell(InitializableMixin):
     def __init__(self) -> None:
         super().__init__()
@@ -434,7 +1186,18 @@ class LocalShell(InitializableMixin):
         encoding: str = "utf-8",
         use_pty: bool = False,
         allow_error: bool = False,
-    ) -> spur.local.LocalProcess:
+    ) -> Union[spur.local.LocalProcess, LocalStreamProcess]:
+        if is_output_kept(stdout):
+            # spur keeps a copy of the whole output, so it's not used for
+            # streaming commands.
+            return LocalStreamProcess(
+                command=command,
+                update_env=update_env,
+                cwd=str(cwd) if cwd else None,
+                stdout=stdout,
+                stderr=stderr,
+                encoding=encoding,
+            )
         return self._inner_shell.spawn(
             command=command,
             update_env=update_env,
@@ -473,6 +1236,10 @@ class LocalShell(InitializableMixin):
         assert isinstance(path, Path), f"actual: {type(path)}"
         return path.stat()
 
+    def read_bytes(self, path: PurePath) -> bytes:
+        assert isinstance(path, Path), f"actual: {type(path)}"
+        return path.read_bytes()
+
     def is_dir(self, path: PurePath) -> bool:
         assert isinstance(path, Path), f"actual: {type(path)}"
         return path.is_dir()
@@ -496,5 +1263,37 @@ class LocalShell(InitializableMixin):
         assert isinstance(node_path, Path), f"actual: {type(node_path)}"
         shutil.copy(local_path, node_path)
 
+    def copy_back(
+        self, node_path: PurePath, local_path: PurePath, log: Optional[Logger] = None
+    ) -> None:
+        assert isinstance(node_path, Path), f"actual: {type(node_path)}"
+        local_path = Path(local_path)
+        local_path.parent.mkdir(parents=True, exist_ok=True)
+        if node_path.is_dir():
+            shutil.copytree(node_path, local_path, dirs_exist_ok=True)
+        else:
+            shutil.copy(node_path, local_path)
+
+    def upload_archive(
+        self, archive: bytes, node_path: PurePath, log: Optional[Logger] = None
+    ) -> None:
+        assert isinstance(node_path, Path), f"actual: {type(node_path)}"
+        node_path.mkdir(parents=True, exist_ok=True)
+        with tarfile.open(fileobj=io.BytesIO(archive), mode="r:gz") as tar:
+            tar.extractall(str(node_path))
+
+
+_ssh_shell_types: Dict[str, Type[SshShell]] = {
+    constants.SHELL_BACKEND_SPUR: SshShell,
+    constants.SHELL_BACKEND_PARAMIKO: ParamikoShell,
+}
+
+
+def create_ssh_shell(connection_info: ConnectionInfo) -> SshShell:
+    shell_type = _ssh_shell_types.get(connection_info.shell_backend)
+    if not shell_type:
+        raise LisaException(f"unknown shell backend: {connection_info.shell_backend}")
+    return shell_type(connection_info)
+
 
 Shell = Union[LocalShell, SshShell]
@@ -0,0 +1,178 @@
+# Copyright (c) Microsoft Corporation.
+# Licensed under the MIT license.
+
+import shlex
+import tarfile
+from pathlib import Path, PurePosixPath
+from typing import IO, Any, Optional, cast
+
+import paramiko
+
+from . import LisaException
+from .logger import Logger
+from .perf_timer import create_timer
+
+# the progress of a long download is logged in the interval.
+_progress_interval = 10
+
+
+class _ProgressReader:
+    """
+    It counts bytes read from the channel, and logs the progress.
+    """
+
+    def __init__(self, file: IO[bytes], name: str, log: Optional[Logger]) -> None:
+        self._file = file
+        self._name = name
+        self._log = log
+        self._timer = create_timer()
+        self._last_logged: float = 0
+        self.size = 0
+
+    @property
+    def elapsed(self) -> float:
+        return self._timer.elapsed(False)
+
+    @property
+    def throughput(self) -> float:
+        """
+        MB per second
+        """
+        elapsed = self.elapsed
+        return self.size / 1024 / 1024 / elapsed if elapsed else 0
+
+    def read(self, size: int = -1) -> bytes:
+        data = self._file.read(size)
+        self.size += len(data)
+        if self._log and self.elapsed - self._last_logged > _progress_interval:
+            self._last_logged = self.elapsed
+            self._log.debug(
+                f"downloading '{self._name}', received {self.size} bytes, "
+                f"{self.throughput:.2f} MB/s"
+            )
+        return data
+
+
+def _rename_member(member: tarfile.TarInfo, source_name: str, target_name: str) -> str:
+    path = PurePosixPath(member.name)
+    if path.is_absolute() or ".." in path.parts:
+        raise LisaException(f"unsafe file '{member.name}' in downloaded archive")
+    if member.name == source_name:
+        return target_name
+    if member.name.startswith(f"{source_name}/"):
+        return f"{target_name}{member.name[len(source_name):]}"
+    raise LisaException(f"unexpected file '{member.name}' in downloaded archive")
+
+
+def download_by_tar(
+    transport: paramiko.Transport,
+    node_path: PurePosixPath,
+    local_path: Path,
+    log: Optional[Logger] = None,
+) -> int:
+    """
+    Download a file or a folder of a posix node. The node compresses it by tar and
+    gzip to stdout of a channel, and it's extracted locally as the stream is
+    received. So it takes one channel, and no temp file on both sides.
+
+    return the size of compressed data.
+    """
+    source_name = node_path.name
+    command = (
+        f"tar -czf - -C {shlex.quote(str(node_path.parent))} "
+        f"{shlex.quote(source_name)}"
+    )
+    local_path.parent.mkdir(parents=True, exist_ok=True)
+
+    channel = transport.open_session()
+    try:
+        channel.exec_command(command)
+        reader = _ProgressReader(channel.makefile("rb"), str(node_path), log)
+        extract_error: Optional[Exception] = None
+        try:
+            # the stream mode reads sequentially, it doesn't need seek.
+            with tarfile.open(fileobj=cast(IO[bytes], reader), mode="r|gz") as tar:
+                _set_safe_filter(tar)
+                for member in tar:
+                    member.name = _rename_member(member, source_name, local_path.name)
+                    if member.islnk():
+                        member.linkname = _rename_member(
+                            tarfile.TarInfo(member.linkname),
+                            source_name,
+                            local_path.name,
+                        )
+                    tar.extract(member, path=str(local_path.parent))
+        except tarfile.TarError as identifier:
+            # the tar may fail on the node, the error is in stderr.
+            extract_error = identifier
+        if extract_error and not channel.exit_status_ready():
+            # the node may be blocked on writing, so don't wait it.
+            stderr = ""
+            exit_code = -1
+        else:
+            stderr = channel.makefile_stderr("rb").read().decode("utf-8", "replace")
+            exit_code = channel.recv_exit_status()
+    finally:
+        channel.close()
+
+    if exit_code != 0 or extract_error:
+        raise LisaException(
+            f"failed to download '{node_path}', exit code: {exit_code}, "
+            f"error: {stderr.strip() or extract_error}"
+        )
+    if log:
+        log.debug(
+            f"downloaded '{node_path}' to '{local_path}', {reader.size} bytes "
+            f"compressed in {reader.elapsed:.1f} sec, {reader.throughput:.2f} MB/s"
+        )
+    return reader.size
+
+
+def upload_by_tar(
+    transport: paramiko.Transport,
+    archive: bytes,
+    node_path: PurePosixPath,
+    log: Optional[Logger] = None,
+) -> None:
+    """
+    Extract a tar.gz archive to a folder of a posix node. The archive is sent to
+    stdin of tar on one channel, so the folder is created, and all files are
+    uploaded and extracted in one round trip.
+    """
+    quoted_path = shlex.quote(str(node_path))
+    command = f"mkdir -p {quoted_path} && tar -xzf - -C {quoted_path}"
+    timer = create_timer()
+
+    channel = transport.open_session()
+    try:
+        channel.exec_command(command)
+        try:
+            channel.sendall(archive)
+        except OSError as identifier:
+            # tar may exit early on errors, the reason is in stderr.
+            if log:
+                log.debug(f"failed to send archive: {identifier}")
+        channel.shutdown_write()
+        stderr = channel.makefile_stderr("rb").read().decode("utf-8", "replace")
+        exit_code = channel.recv_exit_status()
+    finally:
+        channel.close()
+
+    if exit_code != 0:
+        raise LisaException(
+            f"failed to upload archive to '{node_path}', exit code: {exit_code}, "
+            f"error: {stderr.strip()}"
+        )
+    if log:
+        log.debug(
+            f"uploaded {len(archive)} bytes archive to '{node_path}' "
+            f"in {timer.elapsed(False):.1f} sec"
+        )
+
+
+def _set_safe_filter(tar: Any) -> None:
+    # newer pythons check extracted files by the filter, members are also checked
+    # by names in older versions.
+    data_filter = getattr(tarfile, "data_filter", None)
+    if data_filter:
+        tar.extraction_filter = data_filter